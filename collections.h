@@ -359,14 +359,20 @@ namespace lyf
 	public:
 		ForwardLinkedList() {}
 
+		explicit ForwardLinkedList(std::pmr::memory_resource *pResource)
+		{
+			this->_set_resource(pResource);
+		}
+
 		ForwardLinkedList(std::initializer_list<value_type> list)
 			: ForwardLinkedList(list.begin(), list.end())
 		{
 		}
 
 		template<typename Iter>
-		ForwardLinkedList(Iter begin, Iter end)
+		ForwardLinkedList(Iter begin, Iter end, std::pmr::memory_resource *pResource = std::pmr::get_default_resource())
 		{
+			this->_set_resource(pResource);
 			auto _riters = riters(begin, end);
 			for (auto it = _riters.first; it != _riters.second; it++)
 			{
@@ -400,6 +406,7 @@ namespace lyf
 			if (this != &rhs)
 			{
 				this->_destroy();
+				this->_set_resource(rhs._pResource);
 				_head = rhs._head;
 				_size = rhs._size;
 				rhs._head = nullptr;
@@ -426,7 +433,7 @@ namespace lyf
 
 		ForwardLinkedList sublist(nodeptr begin, nodeptr end = nullptr) const
 		{
-			ForwardLinkedList ret;
+			ForwardLinkedList ret(this->_pResource);
 			this->_copy_sublist(ret, *this, begin, end);
 			return ret;
 		}
@@ -434,20 +441,20 @@ namespace lyf
 		// push the value to list head
 		void push(const value_type &value)
 		{
-			_add_node_front(new Node(this, value));
+			_add_node_front(this->_make_node(this, value));
 		}
 
 		// push the value to list head
 		void push(value_type &&value)
 		{
-			_add_node_front(new Node(this, std::move(value)));
+			_add_node_front(this->_make_node(this, std::move(value)));
 		}
 
 		// construct node at list head
 		template<typename... Types>
 		void emplace_front(Types&&... args)
 		{
-			_add_node_front(new Node(this, std::forward<Types>(args)...));
+			_add_node_front(this->_make_node(this, std::forward<Types>(args)...));
 		}
 
 		// pop the node at list head
@@ -466,14 +473,14 @@ namespace lyf
 		// insert a value before the node
 		bool insert(nodeptr node, const value_type &value)
 		{
-			return _insert_node(node, this->_new_node(new Node(this, value)));
+			return _insert_node(node, this->_make_node(this, value));
 		}
 
 		// construct a value before the node
 		template<typename... Types>
 		bool emplace(nodeptr node, Types... args)
 		{
-			return _insert_node(node, this->_new_node(new Node(this, std::forward<Types>(args)...)));
+			return _insert_node(node, this->_make_node(this, std::forward<Types>(args)...));
 		}
 
 		bool remove(nodeptr node)
@@ -530,7 +537,7 @@ namespace lyf
 			nodeptr nd = begin;
 			if (nd && nd != end)
 			{
-				curr = check_t::_new_node(new Node(*nd));
+				curr = dst._make_node(*nd);
 				dst._head = curr;
 				curr->_setCont(&dst);
 				nd = nd->_next;
@@ -538,7 +545,7 @@ namespace lyf
 			}
 			while (nd != end)
 			{	// if end is ahead of begin, a null pointer will be dereferenced
-				curr->_next = check_t::_new_node(new Node(*nd));
+				curr->_next = dst._make_node(*nd);
 				curr = curr->_next;
 				curr->_setCont(&dst);
 				nd = nd->_next;
@@ -546,10 +553,10 @@ namespace lyf
 			}
 		}
 
-		void _add_node_front(Node *node)
+		void _add_node_front(nodeptr np)
 		{
-			node->_next = _head;
-			this->_assign_node(_head, node);
+			np->_next = _head;
+			_head = np;
 			_size++;
 		}
 
@@ -622,6 +629,8 @@ namespace lyf
 	using UniqueForwardLinkedList = ForwardLinkedList<Valt, UniqueNode<Valt>>;
 	template<typename Valt>
 	using SharedForwardLinkedList = ForwardLinkedList<Valt, SharedNode<Valt>>;
+	template<typename Valt>
+	using InlineForwardLinkedList = ForwardLinkedList<Valt, InlineNode<Valt>>;
 
 
 	// binary linked list
@@ -638,14 +647,20 @@ namespace lyf
 	public:
 		LinkedList() {}
 
+		explicit LinkedList(std::pmr::memory_resource *pResource)
+		{
+			this->_set_resource(pResource);
+		}
+
 		LinkedList(std::initializer_list<value_type> list)
 			: LinkedList(list.begin(), list.end())
 		{
 		}
 
 		template<typename Iter>
-		LinkedList(Iter begin, Iter end)
+		LinkedList(Iter begin, Iter end, std::pmr::memory_resource *pResource = std::pmr::get_default_resource())
 		{
+			this->_set_resource(pResource);
 			for (auto it = begin; it != end; it++)
 			{
 				this->push_back(*it);
@@ -684,6 +699,7 @@ namespace lyf
 			if (this != &rhs)
 			{
 				this->_destroy();
+				this->_set_resource(rhs._pResource);
 				_head = rhs._head;
 				_tail = rhs._tail;
 				_size = rhs._size;
@@ -744,7 +760,7 @@ namespace lyf
 
 		LinkedList sublist(nodeptr begin, nodeptr end = nullptr) const
 		{
-			LinkedList ret;
+			LinkedList ret(this->_pResource);
 			this->_copy_sublist(ret, *this, begin, end);
 			return ret;
 		}
@@ -763,39 +779,39 @@ namespace lyf
 		// push the value to list head
 		void push(const value_type &value)
 		{
-			_add_node_front(new Node(this, value));
+			_add_node_front(this->_make_node(this, value));
 		}
 
 		// push the value to list head
 		void push(value_type &&value)
 		{
-			_add_node_front(new Node(this, std::move(value)));
+			_add_node_front(this->_make_node(this, std::move(value)));
 		}
 
 		// construct node at list head
 		template<typename... Types>
 		void emplace_front(Types&&... args)
 		{
-			_add_node_front(new Node(this, std::forward<Types>(args)...));
+			_add_node_front(this->_make_node(this, std::forward<Types>(args)...));
 		}
 
 		// push the value to list tail
 		void push_back(const value_type &value)
 		{
-			_add_node_back(new Node(this, value));
+			_add_node_back(this->_make_node(this, value));
 		}
 
 		// push the value to list tail
 		void push_back(value_type &&value)
 		{
-			_add_node_back(new Node(this, std::move(value)));
+			_add_node_back(this->_make_node(this, std::move(value)));
 		}
 
 		// construct node at list tail
 		template<typename... Types>
 		void emplace_back(Types&&... args)
 		{
-			_add_node_back(new Node(this, std::forward<Types>(args)...));
+			_add_node_back(this->_make_node(this, std::forward<Types>(args)...));
 		}
 
 		// pop the node at list head
@@ -821,14 +837,14 @@ namespace lyf
 		// insert a value before the node
 		bool insert(nodeptr node, const value_type &value)
 		{
-			return _insert_node(node, this->_new_node(new Node(this, value)));
+			return _insert_node(node, this->_make_node(this, value));
 		}
 
 		// construct a value before the node
 		template<typename... Types>
 		bool emplace(nodeptr node, Types... args)
 		{
-			return _insert_node(node, this->_new_node(new Node(this, std::forward<Types>(args)...)));
+			return _insert_node(node, this->_make_node(this, std::forward<Types>(args)...));
 		}
 
 		bool erase(nodeptr node)
@@ -879,7 +895,7 @@ namespace lyf
 			nodeptr nd = begin;
 			if (nd && nd != end)
 			{
-				curr = check_t::_new_node(new Node(*nd));
+				curr = dst._make_node(*nd);
 				dst._head = curr;
 				curr->_setCont(&dst);
 				nd = nd->_next;
@@ -887,7 +903,7 @@ namespace lyf
 			}
 			while (nd != end)
 			{	// if end is ahead of begin, a null pointer will be dereferenced
-				curr->_next = check_t::_new_node(new Node(*nd));
+				curr->_next = dst._make_node(*nd);
 				curr->_next->_prev = curr;
 				curr = curr->_next;
 				curr->_setCont(&dst);
@@ -897,10 +913,9 @@ namespace lyf
 			dst._tail = curr;
 		}
 
-		void _add_node_front(Node *node)
+		void _add_node_front(nodeptr np)
 		{
-			node->_next = _head;
-			auto np = this->_new_node(node);
+			np->_next = _head;
 			if (_head)
 				_head->_prev = np;
 			_head = np;
@@ -909,10 +924,9 @@ namespace lyf
 			_size++;
 		}
 
-		void _add_node_back(Node *node)
+		void _add_node_back(nodeptr np)
 		{
-			node->_prev = _tail;
-			auto np = this->_new_node(node);
+			np->_prev = _tail;
 			if (_tail)
 				_tail->_next = np;
 			_tail = np;
@@ -974,6 +988,8 @@ namespace lyf
 	using UniqueLinkedList = LinkedList<Valt, UniqueNode<Valt>>;
 	template<typename Valt>
 	using SharedLinkedList = LinkedList<Valt, SharedNode<Valt>>;
+	template<typename Valt>
+	using InlineLinkedList = LinkedList<Valt, InlineNode<Valt>>;
 
 
 
@@ -0,0 +1,295 @@
+#pragma once
+#include <vector>
+#include <memory>
+#include "heap.h"
+
+
+
+namespace lyf
+{
+	template<typename HeapType, typename Ele, typename Key = void*>
+	class BaseExternalPriorityQueue
+	{	// priority queue for data larger than memory.
+		// new elements go to an in-memory insertion heap, which is spilled as a sorted run
+		// to its own file when full. pop takes the better of the insertion heap top
+		// and the top of a merge heap holding the head of every run.
+		// run files are written and read sequentially in blocks through Serializer.
+		// runs have levels, spills are level 0 and a compaction merges only the lowest
+		// levels into one run of the next, so each element is rewritten once per level.
+	private:
+		using value_type = Ele;
+		using serializer = Serializer<Ele>;
+
+		class _Run
+		{	// a sorted run on disk and the read-ahead block of it
+		public:
+			_Run(const path &_path, size_t level)
+				: file(_path), total(0), next(0), buffer(), head(0), level(level)
+			{
+			}
+
+			~_Run()
+			{
+				file.close();
+				std::filesystem::remove(file.getPath());
+			}
+
+			_Run(const _Run &) = delete;
+			_Run &operator=(const _Run &) = delete;
+
+			bool empty() const
+			{
+				return head == buffer.size() && next == total;
+			}
+
+			// Move out the current head, reading the next block if needed
+			value_type take(size_t block, std::vector<char> &raw)
+			{
+				if (head == buffer.size())
+					_load(block, raw);
+				return std::move(buffer[head++]);
+			}
+
+			FileModifier file;
+			size_t total;
+			size_t next;
+			std::vector<value_type> buffer;
+			size_t head;
+			size_t level;
+
+		private:
+			void _load(size_t block, std::vector<char> &raw)
+			{
+				size_t n = std::min(block, total - next);
+				raw.resize(n * serializer::SIZE);
+				file.read(next * serializer::SIZE, raw.data(), raw.size());
+				buffer.resize(n);
+				for (size_t i = 0; i != n; i++)
+					serializer::unserialize(raw.data() + i * serializer::SIZE, buffer[i]);
+				next += n;
+				head = 0;
+			}
+		};
+
+		struct _RunKey
+		{	// project a merge entry (run head, run index) to its key
+			Key key;
+
+			INLINE decltype(auto) operator()(const std::pair<value_type, size_t> &e) const
+			{
+				return _Predicate<Key, value_type>::get(key, e.first);
+			}
+		};
+
+		using heap_queue = BasePriorityQueue<HeapType, value_type, Key, std::vector<value_type>, false>;
+		using merge_queue = BasePriorityQueue<HeapType, std::pair<value_type, size_t>, _RunKey,
+			std::vector<std::pair<value_type, size_t>>, false>;
+
+	public:
+		// dir: directory for the run files
+		// memory_bytes: budget, half for the insertion heap, half for the run read-ahead blocks
+		// block_bytes: size of each sequential read or write
+		explicit BaseExternalPriorityQueue(const path &dir, size_t memory_bytes = 1 << 26,
+			size_t block_bytes = 1 << 16, Key key = nullptr)
+			: _Dir(dir), _Heap(key), _Merge(_RunKey{ key }), _Runs(), _RunCount(0), _Size(0), _key(key)
+		{
+			_Block = std::max<size_t>(block_bytes / serializer::SIZE, 1);
+			_HeapCap = std::max<size_t>(memory_bytes / 2 / serializer::SIZE, 1);
+			_MaxRuns = std::max<size_t>(memory_bytes / 2 / (_Block * serializer::SIZE), 2);
+			std::filesystem::create_directories(_Dir);
+		}
+
+		BaseExternalPriorityQueue(const BaseExternalPriorityQueue &) = delete;
+		BaseExternalPriorityQueue &operator=(const BaseExternalPriorityQueue &) = delete;
+
+		size_t size() const { return _Size; }
+
+		bool empty() const { return _Size == 0; }
+
+		// number of sorted runs currently on disk
+		size_t runs() const { return _RunCount; }
+
+		void insert(const value_type &v)
+		{
+			_reserve_one();
+			_Heap.insert(v);
+			_Size++;
+		}
+
+		void insert(value_type &&v)
+		{
+			_reserve_one();
+			_Heap.insert(std::move(v));
+			_Size++;
+		}
+
+		const value_type &get() const
+		{
+			return _from_runs() ? _Merge.get().first : _Heap.get();
+		}
+
+		value_type pop()
+		{
+			if (empty())
+				throw std::runtime_error("pop from empty queue");
+			_Size--;
+			if (_from_runs())
+				return _pop_run_head();
+			return _Heap.pop();
+		}
+
+		void clear()
+		{
+			_Heap.clear();
+			_Merge.clear();
+			_Runs.clear();
+			_RunCount = 0;
+			_Size = 0;
+		}
+
+	private:
+		path const _Dir;
+		heap_queue _Heap;
+		merge_queue _Merge;
+		std::vector<std::unique_ptr<_Run>> _Runs;
+		size_t _RunCount;
+		size_t _Size;
+		size_t _Block;
+		size_t _HeapCap;
+		size_t _MaxRuns;
+		std::vector<char> _Raw;
+		Key _key;
+
+		bool _from_runs() const
+		{
+			if (_Merge.empty())
+				return false;
+			if (_Heap.empty())
+				return true;
+			const value_type &r = _Merge.get().first;
+			return _Heap_traits<HeapType, const value_type*, Key>::compare(&r, &_Heap.get(), _key);
+		}
+
+		value_type _pop_run_head()
+		{
+			auto e = _Merge.pop();
+			_Run &run = *_Runs[e.second];
+			if (!run.empty())
+				_Merge.insert(std::make_pair(run.take(_Block, _Raw), e.second));
+			else
+			{
+				_Runs[e.second].reset();
+				_RunCount--;
+			}
+			return std::move(e.first);
+		}
+
+		void _reserve_one()
+		{
+			if (_Heap.size() < _HeapCap)
+				return;
+			if (_RunCount >= _MaxRuns)
+				_compact();
+			_spill();
+		}
+
+		size_t _new_run(size_t level)
+		{
+			size_t i = 0;
+			while (i != _Runs.size() && _Runs[i])
+				i++;
+			if (i == _Runs.size())
+				_Runs.emplace_back();
+			_Runs[i].reset(new _Run(_Dir / uuid::new_hex(), level));
+			_RunCount++;
+			return i;
+		}
+
+		template<typename Source>
+		void _write_run(size_t i, Source source)
+		{	// Write the elements produced by source to run i block by block.
+			_Run &run = *_Runs[i];
+			std::vector<value_type> block;
+			block.reserve(_Block);
+			while (source(block))
+			{
+				_Raw.resize(block.size() * serializer::SIZE);
+				for (size_t j = 0; j != block.size(); j++)
+					serializer::serialize(_Raw.data() + j * serializer::SIZE, block[j]);
+				run.file.append(_Raw.data(), _Raw.size());
+				run.total += block.size();
+				block.clear();
+			}
+			if (run.total)
+				_Merge.insert(std::make_pair(run.take(_Block, _Raw), i));
+		}
+
+		void _spill()
+		{	// Write the insertion heap as a new sorted run.
+			size_t i = _new_run(0);
+			_write_run(i, [&](std::vector<value_type> &block) {
+				_Heap.pop_n(_Block, std::back_inserter(block));
+				return !block.empty();
+			});
+		}
+
+		// Count the runs at or below level, and find the lowest level above it
+		size_t _count_runs(size_t level, size_t &above) const
+		{
+			size_t n = 0;
+			above = SIZE_MAX;
+			for (auto &run : _Runs)
+				if (run && run->level <= level)
+					n++;
+				else if (run)
+					above = std::min(above, run->level);
+			return n;
+		}
+
+		void _compact()
+		{	// Merge the runs of the lowest levels, at least two, into one run of the next level,
+			// keeping the number of read blocks bounded.
+			size_t top, above, n = _count_runs(0, above);
+			for (top = 0; n < 2 && above != SIZE_MAX; n = _count_runs(top, above))
+				top = above;
+			merge_queue merging(_RunKey{ _key }), rest(_RunKey{ _key });
+			while (!_Merge.empty())
+			{
+				auto e = _Merge.pop();
+				if (_Runs[e.second]->level <= top)
+					merging.insert(std::move(e));
+				else
+					rest.insert(std::move(e));
+			}
+			_Merge = std::move(rest);
+			std::vector<std::unique_ptr<_Run>> sources(_Runs.size());
+			for (size_t j = 0; j != _Runs.size(); j++)
+				if (_Runs[j] && _Runs[j]->level <= top)
+				{
+					sources[j] = std::move(_Runs[j]);
+					_RunCount--;
+				}
+			size_t i = _new_run(top + 1);
+			_write_run(i, [&](std::vector<value_type> &block) {
+				while (block.size() != _Block && !merging.empty())
+				{
+					auto e = merging.pop();
+					_Run &run = *sources[e.second];
+					if (!run.empty())
+						merging.insert(std::make_pair(run.take(_Block, _Raw), e.second));
+					else
+						sources[e.second].reset();
+					block.push_back(std::move(e.first));
+				}
+				return !block.empty();
+			});
+		}
+	};
+
+
+	template<typename Ele, typename Key = void*>
+	using ExternalMaxPriorityQueue = BaseExternalPriorityQueue<_HeapMax, Ele, Key>;
+
+	template<typename Ele, typename Key = void*>
+	using ExternalMinPriorityQueue = BaseExternalPriorityQueue<_HeapMin, Ele, Key>;
+}
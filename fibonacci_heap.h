@@ -1,5 +1,10 @@
 #pragma once
 #include <cmath>
+#include <memory>
+#include <algorithm>
+#include <vector>
+#include <type_traits>
+#include <memory_resource>
 #include "utils.h"
 
 
@@ -17,37 +22,23 @@ namespace lyf
 			using value_ptr = std::unique_ptr<_Ty>;
 
 			Node(const _Ty &value)
-				: _pValue(new _Ty(value)), _pParent(nullptr), _Degree(0),
+				: _Value(value), _pParent(nullptr), _Degree(0),
 				_pChild(nullptr), _pLeft(nullptr), _pRight(nullptr), _Mark(false)
 			{
 			}
 
 			Node(_Ty &&value)
-				: _pValue(new _Ty(std::move(value))), _pParent(nullptr), _Degree(0),
+				: _Value(std::move(value)), _pParent(nullptr), _Degree(0),
 				_pChild(nullptr), _pLeft(nullptr), _pRight(nullptr), _Mark(false)
 			{
 			}
 
-			~Node()
-			{
-				if (_pChild)
-				{
-					node_ptr curr = _pChild;
-					do
-					{
-						node_ptr next = curr->_pRight;
-						delete curr;
-						curr = next;
-					} while (curr != _pChild);
-				}
-			}
-
 			const _Ty &value() const noexcept
 			{
-				return *_pValue;
+				return _Value;
 			}
 
-			value_ptr _pValue;
+			_Ty _Value;
 			node_ptr _pParent;
 			node_ptr _pChild;
 			node_ptr _pLeft;
@@ -56,6 +47,131 @@ namespace lyf
 			bool _Mark;
 		};
 
+		class _NodePool
+		{	// hands out nodes from slabs of growing size taken from a memory resource,
+			// freed nodes go to a free list and slabs are only released all at once
+		private:
+			union _Slot
+			{
+				_Slot *pNext;
+				alignas(Node) unsigned char raw[sizeof(Node)];
+			};
+
+			struct _Slab
+			{
+				_Slot *pSlots;
+				size_t count;
+				std::pmr::memory_resource *pResource;
+			};
+
+		public:
+			explicit _NodePool(std::pmr::memory_resource *pResource = std::pmr::get_default_resource()) noexcept
+				: _Slabs(), _pFree(nullptr), _pBump(nullptr), _pBumpEnd(nullptr), _pResource(pResource)
+			{
+			}
+
+			_NodePool(_NodePool &&rhs) noexcept
+				: _Slabs(std::move(rhs._Slabs)), _pFree(rhs._pFree), _pBump(rhs._pBump), _pBumpEnd(rhs._pBumpEnd),
+				_pResource(rhs._pResource)
+			{
+				rhs._reset();
+			}
+
+			~_NodePool()
+			{
+				release();
+			}
+
+			_NodePool &operator=(_NodePool &&rhs) noexcept
+			{
+				if (this != &rhs)
+				{
+					release();
+					_Slabs = std::move(rhs._Slabs);
+					_pFree = rhs._pFree;
+					_pBump = rhs._pBump;
+					_pBumpEnd = rhs._pBumpEnd;
+					_pResource = rhs._pResource;
+					rhs._reset();
+				}
+				return *this;
+			}
+
+			template<typename... Types>
+			Node *construct(Types&&... args)
+			{
+				_Slot *p = _pFree;
+				if (p)
+					_pFree = p->pNext;
+				else
+				{
+					if (_pBump == _pBumpEnd)
+						_grow();
+					p = _pBump++;
+				}
+				return new (p->raw) Node(std::forward<Types>(args)...);
+			}
+
+			void destroy(Node *np) noexcept
+			{
+				np->~Node();
+				_Slot *p = reinterpret_cast<_Slot*>(np);
+				p->pNext = _pFree;
+				_pFree = p;
+			}
+
+			std::pmr::memory_resource *resource() const noexcept
+			{
+				return _pResource;
+			}
+
+			// Take over the slabs of rhs, whose nodes now belong to this pool,
+			// each slab is still returned to the resource it came from
+			void adopt(_NodePool &rhs)
+			{
+				_Slabs.insert(_Slabs.end(), rhs._Slabs.begin(), rhs._Slabs.end());
+				if (rhs._pFree)
+				{
+					_Slot *p = rhs._pFree;
+					while (p->pNext)
+						p = p->pNext;
+					p->pNext = _pFree;
+					_pFree = rhs._pFree;
+				}
+				rhs._reset();
+			}
+
+			// Release every slab, the nodes must have been destroyed already
+			void release() noexcept
+			{
+				for (const _Slab &slab : _Slabs)
+					slab.pResource->deallocate(slab.pSlots, slab.count * sizeof(_Slot), alignof(_Slot));
+				_reset();
+			}
+
+		private:
+			std::vector<_Slab> _Slabs;
+			_Slot *_pFree;
+			_Slot *_pBump;
+			_Slot *_pBumpEnd;
+			std::pmr::memory_resource *_pResource;
+
+			void _grow()
+			{
+				size_t n = size_t(32) << std::min<size_t>(_Slabs.size(), 7);
+				_Slabs.reserve(_Slabs.size() + 1);
+				_pBump = static_cast<_Slot*>(_pResource->allocate(n * sizeof(_Slot), alignof(_Slot)));
+				_pBumpEnd = _pBump + n;
+				_Slabs.push_back(_Slab{ _pBump, n, _pResource });
+			}
+
+			void _reset() noexcept
+			{
+				_Slabs.clear();
+				_pFree = _pBump = _pBumpEnd = nullptr;
+			}
+		};
+
 	public:
 		using value_type = _Ty;
 		using node_ptr = typename Node::node_ptr;
@@ -63,12 +179,17 @@ namespace lyf
 		
 	public:
 		FibonacciHeap() noexcept
-			: _pRoot(nullptr), _Size(0)
+			: _pRoot(nullptr), _Size(0), _Pool()
+		{
+		}
+
+		explicit FibonacciHeap(std::pmr::memory_resource *pResource) noexcept
+			: _pRoot(nullptr), _Size(0), _Pool(pResource)
 		{
 		}
 
 		FibonacciHeap(FibonacciHeap &&rhs) noexcept
-			: _pRoot(rhs._pRoot), _Size(rhs._Size)
+			: _pRoot(rhs._pRoot), _Size(rhs._Size), _Pool(std::move(rhs._Pool))
 		{
 			rhs._pRoot = nullptr;
 			rhs._Size = 0;
@@ -76,24 +197,17 @@ namespace lyf
 
 		~FibonacciHeap()
 		{
-			if (_pRoot)
-			{
-				node_ptr curr = _pRoot;
-				do
-				{
-					node_ptr next = curr->_pRight;
-					delete curr;
-					curr = next;
-				} while (curr != _pRoot);
-			}
+			clear();
 		}
 
 		FibonacciHeap &operator=(FibonacciHeap &&rhs) noexcept
 		{
 			if (this != &rhs)
 			{
+				clear();
 				_pRoot = rhs._pRoot;
 				_Size = rhs._Size;
+				_Pool = std::move(rhs._Pool);
 				rhs._pRoot = nullptr;
 				rhs._Size = 0;
 			}
@@ -117,6 +231,7 @@ namespace lyf
 					_pRoot = rhs._pRoot;
 				}
 				_Size += rhs._Size;
+				_Pool.adopt(rhs._Pool);
 				rhs._pRoot = nullptr;
 				rhs._Size = 0;
 			}
@@ -128,14 +243,71 @@ namespace lyf
 			return (*this) += std::move(rhs);
 		}
 
-		void insert(const value_type &value) noexcept
+		// The returned node stays valid as a handle until its value is extracted or erased
+		node_ptr insert(const value_type &value) noexcept
+		{
+			node_ptr np = _Pool.construct(value);
+			_insert_new_node(np);
+			return np;
+		}
+
+		node_ptr insert(value_type &&value) noexcept
+		{
+			node_ptr np = _Pool.construct(std::move(value));
+			_insert_new_node(np);
+			return np;
+		}
+
+		void decrease_key(node_ptr np, const value_type &value)
+		{
+			if (np->value() < value)
+				throw std::runtime_error("new value is greater than current value");
+			np->_Value = value;
+			_decreased(np);
+		}
+
+		void decrease_key(node_ptr np, value_type &&value)
+		{
+			if (np->value() < value)
+				throw std::runtime_error("new value is greater than current value");
+			np->_Value = std::move(value);
+			_decreased(np);
+		}
+
+		// Change the value of the node in either direction, the handle stays valid
+		void update(node_ptr np, const value_type &value)
 		{
-			_insert_new_node(new Node(value));
+			if (value < np->value())
+				decrease_key(np, value);
+			else
+			{
+				np->_Value = value;
+				_increased(np);
+			}
 		}
 
-		void insert(value_type &&value) noexcept
+		void update(node_ptr np, value_type &&value)
 		{
-			_insert_new_node(new Node(std::move(value)));
+			if (value < np->value())
+				decrease_key(np, std::move(value));
+			else
+			{
+				np->_Value = std::move(value);
+				_increased(np);
+			}
+		}
+
+		// Remove the node from the heap and return its value
+		value_ptr erase(node_ptr np) noexcept
+		{
+			node_ptr pp = np->_pParent;
+			if (pp)
+			{
+				_cut(np, pp);
+				_cascading_cut(pp);
+			}
+			_pRoot = np;
+			return extract_min();
 		}
 
 		value_ptr extract_min() noexcept
@@ -167,12 +339,57 @@ namespace lyf
 				}
 				_Size--;
 				_consolidate();
-				ret = std::move(np->_pValue);
-				delete np;
+				ret.reset(new _Ty(std::move(np->_Value)));
+				_Pool.destroy(np);
 			}
 			return ret;
 		}
 
+		// Extract the k smallest values into out in ascending order, returns the number extracted.
+		// the extracted nodes are selected through a binary heap over the candidate roots,
+		// and the remaining trees are consolidated once at the end
+		template<typename OutputIter>
+		size_t extract_min_n(size_t k, OutputIter out)
+		{
+			k = std::min(k, _Size);
+			if (!k)
+				return 0;
+			auto greater = [](node_ptr a, node_ptr b) { return b->value() < a->value(); };
+			std::vector<node_ptr> &cands = _Candidates;
+			_append_ring(cands, _pRoot);
+			std::make_heap(cands.begin(), cands.end(), greater);
+			for (size_t i = 0; i != k; i++)
+			{
+				std::pop_heap(cands.begin(), cands.end(), greater);
+				node_ptr np = cands.back();
+				cands.pop_back();
+				size_t first = cands.size();
+				_append_ring(cands, np->_pChild);
+				for (size_t j = first; j != cands.size(); j++)
+					std::push_heap(cands.begin(), cands.begin() + j + 1, greater);
+				*out++ = std::move(np->_Value);
+				_Pool.destroy(np);
+			}
+			_Size -= k;
+			_pRoot = nullptr;
+			for (node_ptr np : cands)
+			{
+				_insert_node_after(np, _pRoot);
+				np->_pParent = nullptr;
+				np->_Mark = false;
+			}
+			cands.clear();
+			_consolidate();
+			return k;
+		}
+
+		// Extract every value into out in ascending order
+		template<typename OutputIter>
+		size_t drain(OutputIter out)
+		{
+			return extract_min_n(_Size, out);
+		}
+
 		size_t size() const noexcept
 		{
 			return _Size;
@@ -193,9 +410,53 @@ namespace lyf
 			return _pRoot->value();
 		}
 
+		// the memory resource node slabs are allocated from
+		std::pmr::memory_resource *get_resource() const noexcept
+		{
+			return _Pool.resource();
+		}
+
+		void clear() noexcept
+		{
+			if (!std::is_trivially_destructible<_Ty>::value && _pRoot)
+			{	// splice each child list into the root list instead of recursing into it
+				node_ptr curr = _pRoot;
+				while (curr)
+				{
+					if (curr->_pChild)
+					{
+						_concatenate_childs(curr, curr->_pChild);
+						curr->_pChild = nullptr;
+					}
+					node_ptr next = curr->_pRight == curr ? nullptr : curr->_pRight;
+					_remove_node(curr);
+					curr->~Node();
+					curr = next;
+				}
+			}
+			_pRoot = nullptr;
+			_Size = 0;
+			_Pool.release();
+		}
+
 	private:
 		node_ptr _pRoot;
 		size_t _Size;
+		_NodePool _Pool;
+		std::vector<node_ptr> _Degrees;
+		std::vector<node_ptr> _Candidates;
+
+		static void _append_ring(std::vector<node_ptr> &vec, node_ptr first)
+		{
+			if (!first)
+				return;
+			node_ptr curr = first;
+			do
+			{
+				vec.push_back(curr);
+				curr = curr->_pRight;
+			} while (curr != first);
+		}
 
 		void _concatenate_childs(node_ptr lc, node_ptr rc) noexcept
 		{
@@ -246,11 +507,89 @@ namespace lyf
 			}
 		}
 
+		void _cut(node_ptr np, node_ptr pp) noexcept
+		{	// move np from the child list of pp to the root list
+			if (np->_pRight == np)
+				pp->_pChild = nullptr;
+			else
+			{
+				if (pp->_pChild == np)
+					pp->_pChild = np->_pRight;
+				_remove_node(np);
+			}
+			pp->_Degree--;
+			_insert_node_after(np, _pRoot);
+			np->_pParent = nullptr;
+			np->_Mark = false;
+		}
+
+		void _cascading_cut(node_ptr np) noexcept
+		{	// cut marked ancestors until an unmarked one, which is marked instead
+			node_ptr pp = np->_pParent;
+			while (pp)
+			{
+				if (!np->_Mark)
+				{
+					np->_Mark = true;
+					return;
+				}
+				_cut(np, pp);
+				np = pp;
+				pp = np->_pParent;
+			}
+		}
+
+		void _decreased(node_ptr np) noexcept
+		{
+			node_ptr pp = np->_pParent;
+			if (pp && np->value() < pp->value())
+			{
+				_cut(np, pp);
+				_cascading_cut(pp);
+			}
+			if (np->value() < _pRoot->value())
+				_pRoot = np;
+		}
+
+		void _increased(node_ptr np) noexcept
+		{	// children may now be smaller than np, so they all become roots
+			node_ptr cp = np->_pChild;
+			if (cp)
+			{
+				node_ptr curr = cp;
+				do
+				{
+					curr->_pParent = nullptr;
+					curr->_Mark = false;
+					curr = curr->_pRight;
+				} while (curr != cp);
+				_concatenate_childs(_pRoot, cp);
+				np->_pChild = nullptr;
+				np->_Degree = 0;
+			}
+			node_ptr pp = np->_pParent;
+			if (pp)
+			{
+				_cut(np, pp);
+				_cascading_cut(pp);
+			}
+			if (np == _pRoot)
+			{
+				node_ptr curr = np->_pRight;
+				while (curr != np)
+				{
+					if (curr->value() < _pRoot->value())
+						_pRoot = curr;
+					curr = curr->_pRight;
+				}
+			}
+		}
+
 		void _consolidate() noexcept
 		{
 			if (!size())
 				return;
-			std::vector<node_ptr> roots(max_degree(), nullptr);
+			std::vector<node_ptr> &roots = _Degrees;
 			node_ptr r = _pRoot, curr = r;
 			if (r)
 			{
@@ -258,6 +597,8 @@ namespace lyf
 				{
 					node_ptr x = curr, next = curr->_pRight;
 					size_t d = x->_Degree;
+					if (roots.size() <= d + 1)
+						roots.resize(d + 2, nullptr);
 					while (roots[d])
 					{
 						node_ptr y = roots[d];
@@ -282,13 +623,15 @@ namespace lyf
 						y->_Mark = false;
 						roots[d] = nullptr;
 						d++;
+						if (roots.size() == d + 1)
+							roots.push_back(nullptr);
 					}
 					roots[d] = x;
 					curr = next;
 				} while (curr != r);
 			}
 			_pRoot = nullptr;
-			for (auto np : roots)
+			for (auto &np : roots)
 			{
 				if (np)
 				{
@@ -298,6 +641,7 @@ namespace lyf
 					{
 						_pRoot = np;
 					}
+					np = nullptr;
 				}
 			}
 		}
@@ -1,4 +1,5 @@
 #pragma once
+#include <limits>
 #include "utils.h"
 
 
@@ -180,19 +181,121 @@ namespace lyf
 	using MinHeap = BaseHeap<_HeapMin, Iter, Key>;
 
 
+	template<typename Key, typename Ele, typename = void>
+	struct CachePriorityKey : std::false_type
+	{	// Whether BasePriorityQueue stores the projected key next to each element,
+		// specialize it to force or disable the cache for a key.
+	};
+
+	template<typename Key, typename Ele>
+	struct CachePriorityKey<Key, Ele, std::enable_if_t<!std::is_same_v<Key, void*>>>
+		: std::bool_constant<std::is_scalar_v<std::decay_t<
+		decltype(_Predicate<Key, Ele>::get(std::declval<Key>(), std::declval<const Ele&>()))>>>
+	{	// cache by default when the projection yields a scalar
+	};
+
+	template<typename Container, typename T, bool Rebind = true>
+	struct _RebindContainer;
+
+	template<template<typename, typename> class C, typename E, typename A, typename T>
+	struct _RebindContainer<C<E, A>, T, true>
+	{
+		using type = C<T, typename std::allocator_traits<A>::template rebind_alloc<T>>;
+	};
+
+	template<typename Container, typename T>
+	struct _RebindContainer<Container, T, false>
+	{	// the elements are stored as they are, keep the container given
+		using type = Container;
+	};
+
+	template<typename Ele, typename Key, bool CacheKey>
+	struct _PQEntry_traits
+	{	// entries are the elements, compared through Key
+		using entry_type = Ele;
+		using heap_key = Key;
+
+		INLINE static heap_key heap_key_of(Key key) { return key; }
+
+		INLINE static const Ele &value(const entry_type &e) { return e; }
+		INLINE static Ele &value(entry_type &e) { return e; }
+
+		template<typename Container, typename... Types>
+		INLINE static void emplace(Container &data, Key key, Types&&... args)
+		{
+			data.emplace_back(std::forward<Types>(args)...);
+		}
+
+		template<typename Container, typename Iter>
+		INLINE static void append(Container &data, Key key, Iter begin, Iter end)
+		{
+			data.insert(data.end(), begin, end);
+		}
+	};
+
+	template<typename Ele, typename Key>
+	struct _PQEntry_traits<Ele, Key, true>
+	{	// entries are (key, element) pairs, compared by the cached key only
+		using key_type = std::decay_t<decltype(_Predicate<Key, Ele>::get(std::declval<Key>(), std::declval<const Ele&>()))>;
+		using entry_type = std::pair<key_type, Ele>;
+
+		struct heap_key
+		{
+			INLINE const key_type &operator()(const entry_type &e) const { return e.first; }
+		};
+
+		INLINE static heap_key heap_key_of(Key key) { return heap_key(); }
+
+		INLINE static const Ele &value(const entry_type &e) { return e.second; }
+		INLINE static Ele &value(entry_type &e) { return e.second; }
+
+		template<typename Container>
+		INLINE static void emplace(Container &data, Key key, const Ele &v)
+		{
+			data.emplace_back(_Predicate<Key, Ele>::get(key, v), v);
+		}
+
+		template<typename Container>
+		INLINE static void emplace(Container &data, Key key, Ele &&v)
+		{
+			key_type k = _Predicate<Key, Ele>::get(key, v);
+			data.emplace_back(std::move(k), std::move(v));
+		}
+
+		template<typename Container, typename... Types>
+		INLINE static void emplace(Container &data, Key key, Types&&... args)
+		{
+			emplace(data, key, Ele(std::forward<Types>(args)...));
+		}
+
+		template<typename Container, typename Iter>
+		INLINE static void append(Container &data, Key key, Iter begin, Iter end)
+		{
+			for (; begin != end; ++begin)
+				emplace(data, key, *begin);
+		}
+	};
+
+
 	template<typename HeapType,
 		typename Ele,
 		typename Key = void*,
-		typename Container = std::vector<Ele>>
+		typename Container = std::vector<Ele>,
+		bool CacheKey = CachePriorityKey<Key, Ele>::value>
 	class BasePriorityQueue
-	{	// priority queue by heap
+	{	// priority queue by heap,
+		// with CacheKey the projected key is stored next to each element
+		// so sift operations compare the cached keys only.
 	private:
 		using value_type = Ele;
-		using iter_type = typename Container::iterator;
-		using heap_type = BaseHeap<HeapType, iter_type, Key>;
+		using entry_traits = _PQEntry_traits<Ele, Key, CacheKey>;
+		using entry_type = typename entry_traits::entry_type;
+		using storage_type = typename _RebindContainer<Container, entry_type, CacheKey>::type;
+		using iter_type = typename storage_type::iterator;
+		using heap_type = BaseHeap<HeapType, iter_type, typename entry_traits::heap_key>;
 	public:
 		explicit BasePriorityQueue(Key key = nullptr)
-			:heap(heap_type(key))
+			:heap(heap_type(entry_traits::heap_key_of(key))), key(key)
 		{
 		}
 
@@ -204,61 +307,129 @@ namespace lyf
 
 		template<typename Iter>
 		BasePriorityQueue(Iter begin, Iter end, Key key = nullptr)
-			: heap(heap_type(key)), data(Container(begin, end))
+			: BasePriorityQueue(key)
 		{
+			entry_traits::append(data, key, begin, end);
 			reset_heap();
 			heap.build();
 		}
 
 		size_t size() const { return data.size(); }
 
-		void insert(value_type v)
+		void insert(const value_type &v)
 		{
-			data.push_back(v);
+			entry_traits::emplace(data, key, v);
 			reset_heap();
 			heap.heapify_up(data.end() - 1);
 		}
 
-		value_type get() const
+		void insert(value_type &&v)
 		{
-			return data.front();
+			entry_traits::emplace(data, key, std::move(v));
+			reset_heap();
+			heap.heapify_up(data.end() - 1);
+		}
+
+		template<typename... Types>
+		void emplace(Types&&... args)
+		{
+			entry_traits::emplace(data, key, std::forward<Types>(args)...);
+			reset_heap();
+			heap.heapify_up(data.end() - 1);
+		}
+
+		template<typename Iter>
+		void insert_range(Iter begin, Iter end)
+		{	// Append the batch, rebuild in O(n) time if it's large relative to the heap.
+			size_t old_size = size();
+			entry_traits::append(data, key, begin, end);
+			size_t count = size() - old_size;
+			if (!count || !reset_heap())
+				return;
+			if (count * _log2(size()) >= size())
+			{
+				heap.build();
+				return;
+			}
+			for (auto it = data.begin() + old_size; it != data.end(); ++it)
+				heap.heapify_up(it);
+		}
+
+		const value_type &get() const
+		{
+			return entry_traits::value(data.front());
 		}
 
 		value_type pop()
 		{
-			auto r = data.front();
 			swap_by_iter(data.begin(), data.end() - 1);
+			value_type r = std::move(entry_traits::value(data.back()));
 			data.pop_back();
 			if (reset_heap())
 				heap.heapify_down(data.begin());
 			return r;
 		}
 
+		template<typename OutIter>
+		OutIter pop_n(size_t k, OutIter out)
+		{	// Pop at most k elements into out in priority order.
+			// The heap shrinks in place as in heap sort, then the tail is moved out once.
+			k = std::min(k, size());
+			if (!k)
+				return out;
+			auto stop = data.end() - k;
+			for (auto last = data.end() - 1; ; --last)
+			{
+				swap_by_iter(data.begin(), last);
+				if (!heap.reset(data.begin(), last))
+					break;
+				heap.heapify_down(data.begin());
+				if (last == stop)
+					break;
+			}
+			for (auto it = data.end(); it != stop; )
+				*out++ = std::move(entry_traits::value(*--it));
+			data.erase(stop, data.end());
+			reset_heap();
+			return out;
+		}
+
 		void clear() { data.clear(); }
 
 		bool empty() const { return size() == 0; }
 
 	private:
-		Container data;
+		storage_type data;
 		heap_type heap;
+		Key key = nullptr;
 
 		bool reset_heap()
 		{
 			return heap.reset(data.begin(), data.end());
 		}
 
+		static size_t _log2(size_t n)
+		{
+			size_t r = 0;
+			while (n >>= 1)
+				r++;
+			return r;
+		}
+
 	};
 
 
 	template<typename Ele,
 		typename Key = void*,
-		typename Container = std::vector<Ele>>
-	using MaxPriorityQueue = BasePriorityQueue<_HeapMax, Ele, Key, Container>;
+		typename Container = std::vector<Ele>,
+		bool CacheKey = CachePriorityKey<Key, Ele>::value>
+	using MaxPriorityQueue = BasePriorityQueue<_HeapMax, Ele, Key, Container, CacheKey>;
 
 	template<typename Ele,
 		typename Key = void*,
-		typename Container = std::vector<Ele>>
-	using MinPriorityQueue = BasePriorityQueue<_HeapMin, Ele, Key, Container>;
+		typename Container = std::vector<Ele>,
+		bool CacheKey = CachePriorityKey<Key, Ele>::value>
+	using MinPriorityQueue = BasePriorityQueue<_HeapMin, Ele, Key, Container, CacheKey>;
 
 	template<typename Ele,
 		typename Key = void*,
@@ -311,4 +482,555 @@ namespace lyf
 	{
 		return MinPriorityQueue<Ele, Key, Container>(begin, end, key);
 	}
+
+
+	template<typename Ele,
+		typename Key = void*,
+		typename Container = std::vector<Ele>>
+	class MinMaxPriorityQueue
+	{	// double-ended priority queue by min-max heap,
+		// nodes on even levels are no greater than their descendants,
+		// nodes on odd levels are no less than their descendants.
+	private:
+		using value_type = Ele;
+		using iter_type = typename Container::iterator;
+
+	public:
+		explicit MinMaxPriorityQueue(Key key = nullptr)
+			: key(key)
+		{
+		}
+
+		explicit MinMaxPriorityQueue(size_t init_cap, Key key = nullptr)
+			: MinMaxPriorityQueue(key)
+		{
+			data.reserve(init_cap);
+		}
+
+		template<typename Iter>
+		MinMaxPriorityQueue(Iter begin, Iter end, Key key = nullptr)
+			: data(Container(begin, end)), key(key)
+		{
+			build();
+		}
+
+		size_t size() const { return data.size(); }
+
+		bool empty() const { return size() == 0; }
+
+		void clear() { data.clear(); }
+
+		void insert(const value_type &v)
+		{
+			data.push_back(v);
+			heapify_up(size() - 1);
+		}
+
+		void insert(value_type &&v)
+		{
+			data.push_back(std::move(v));
+			heapify_up(size() - 1);
+		}
+
+		template<typename... Types>
+		void emplace(Types&&... args)
+		{
+			data.emplace_back(std::forward<Types>(args)...);
+			heapify_up(size() - 1);
+		}
+
+		const value_type &min() const
+		{
+			return data.front();
+		}
+
+		const value_type &max() const
+		{
+			return data[max_index()];
+		}
+
+		value_type pop_min()
+		{
+			return pop_at(0);
+		}
+
+		value_type pop_max()
+		{
+			return pop_at(max_index());
+		}
+
+	private:
+		Container data;
+		Key key = nullptr;
+
+		static bool is_min_level(size_t i)
+		{
+			size_t level = 0;
+			for (++i; i >>= 1; )
+				level++;
+			return (level & 1) == 0;
+		}
+
+		template<typename HeapType>
+		INLINE bool compare(size_t i, size_t j)
+		{
+			return _Heap_traits<HeapType, iter_type, Key>::compare(data.begin() + i, data.begin() + j, key);
+		}
+
+		INLINE void swap_at(size_t i, size_t j)
+		{
+			swap_by_iter(data.begin() + i, data.begin() + j);
+		}
+
+		size_t max_index() const
+		{
+			if (size() <= 2)
+				return size() - 1;
+			auto it = data.begin();
+			return iter_less(it + 1, it + 2, key) ? 2 : 1;
+		}
+
+		value_type pop_at(size_t i)
+		{
+			swap_at(i, size() - 1);
+			value_type r = std::move(data.back());
+			data.pop_back();
+			if (i < size())
+				heapify_down(i);
+			return r;
+		}
+
+		void build()
+		{	// Build the heap in O(n) time.
+			for (size_t i = size() / 2; i-- > 0; )
+				heapify_down(i);
+		}
+
+		void heapify_up(size_t i)
+		{
+			if (i == 0)
+				return;
+			size_t p = (i - 1) / 2;
+			if (is_min_level(i))
+			{
+				if (compare<_HeapMax>(i, p))
+				{
+					swap_at(i, p);
+					heapify_up<_HeapMax>(p);
+				}
+				else
+					heapify_up<_HeapMin>(i);
+			}
+			else
+			{
+				if (compare<_HeapMin>(i, p))
+				{
+					swap_at(i, p);
+					heapify_up<_HeapMin>(p);
+				}
+				else
+					heapify_up<_HeapMax>(i);
+			}
+		}
+
+		template<typename HeapType>
+		void heapify_up(size_t i)
+		{	// Move up through the grandparents on levels of the same kind.
+			while (i > 2)
+			{
+				size_t g = ((i - 1) / 2 - 1) / 2;
+				if (!compare<HeapType>(i, g))
+					break;
+				swap_at(i, g);
+				i = g;
+			}
+		}
+
+		void heapify_down(size_t i)
+		{
+			if (is_min_level(i))
+				heapify_down<_HeapMin>(i);
+			else
+				heapify_down<_HeapMax>(i);
+		}
+
+		template<typename HeapType>
+		void heapify_down(size_t i)
+		{	// Maintain the heap property from the node to leaf in O(lgn) time,
+			// stepping over the levels of the other kind.
+			const size_t n = size();
+			while (2 * i + 1 < n)
+			{
+				size_t most = 2 * i + 1;
+				size_t candidates[] = { 2 * i + 2, 4 * i + 3, 4 * i + 4, 4 * i + 5, 4 * i + 6 };
+				for (size_t c : candidates)
+				{
+					if (c < n && compare<HeapType>(c, most))
+						most = c;
+				}
+				if (!compare<HeapType>(most, i))
+					break;
+				swap_at(most, i);
+				if (most <= 2 * i + 2)
+					break;
+				size_t p = (most - 1) / 2;
+				if (compare<HeapType>(p, most))
+					swap_at(p, most);
+				i = most;
+			}
+		}
+	};
+
+	template<typename Ele,
+		typename Key = void*,
+		typename Container = std::vector<Ele>,
+		typename X = typename std::enable_if<std::is_class_v<Key> || std::is_pointer_v<Key>>::type>
+	auto newMinMaxPriorityQueue(Key key = nullptr)
+	{
+		return MinMaxPriorityQueue<Ele, Key, Container>(key);
+	}
+
+	template<typename Ele,
+		typename Key = void*,
+		typename Container = std::vector<Ele>>
+	auto newMinMaxPriorityQueue(size_t init_cap, Key key = nullptr)
+	{
+		return MinMaxPriorityQueue<Ele, Key, Container>(init_cap, key);
+	}
+
+	template<typename Iter,
+		typename Ele = typename Iter_traits<Iter>::value_type,
+		typename Key = void*,
+		typename Container = std::vector<Ele>>
+	auto newMinMaxPriorityQueue(Iter begin, Iter end, Key key = nullptr)
+	{
+		return MinMaxPriorityQueue<Ele, Key, Container>(begin, end, key);
+	}
+
+
+	template<typename Ele, typename Key = void*>
+	class TopK
+	{	// bounded accumulator keeping the k largest elements seen,
+		// a min heap of k elements whose root is the threshold to enter.
+	private:
+		using value_type = Ele;
+		using Container = std::vector<Ele>;
+		using iter_type = typename Container::iterator;
+		using heap_type = MinHeap<iter_type, Key>;
+
+	public:
+		explicit TopK(size_t k, Key key = nullptr)
+			: k(k), heap(key), key(key)
+		{
+			data.reserve(k);
+		}
+
+		size_t capacity() const { return k; }
+
+		size_t size() const { return data.size(); }
+
+		bool empty() const { return size() == 0; }
+
+		bool full() const { return size() == k; }
+
+		void clear() { data.clear(); }
+
+		// The smallest kept element, the one to be evicted next
+		const value_type &threshold() const
+		{
+			return data.front();
+		}
+
+		// Whether the value would enter the accumulator
+		bool accepts(const value_type &v) const
+		{
+			return !full() || (k && iter_less(&data.front(), &v, key));
+		}
+
+		bool push(const value_type &v)
+		{
+			if (!accepts(v))
+				return false;
+			if (full())
+				_replace_top(v);
+			else
+				_push_back(v);
+			return true;
+		}
+
+		bool push(value_type &&v)
+		{
+			if (!accepts(v))
+				return false;
+			if (full())
+				_replace_top(std::move(v));
+			else
+				_push_back(std::move(v));
+			return true;
+		}
+
+		template<typename Iter>
+		void push_range(Iter begin, Iter end)
+		{	// Fill up to k and build once in O(k) time,
+			// then only elements beating the threshold touch the heap.
+			if (!k)
+				return;
+			if (!full())
+			{
+				while (begin != end && !full())
+				{
+					data.push_back(*begin);
+					++begin;
+				}
+				if (heap.reset(data.begin(), data.end()))
+					heap.build();
+			}
+			for (; begin != end; ++begin)
+			{	// bind a const reference, *begin may be const or an rvalue
+				const value_type &v = *begin;
+				if (iter_less(&std::as_const(data.front()), &v, key))
+					_replace_top(*begin);
+			}
+		}
+
+		TopK &merge(const TopK &rhs)
+		{
+			if (this != &rhs)
+				push_range(rhs.data.begin(), rhs.data.end());
+			return *this;
+		}
+
+		TopK &merge(TopK &&rhs)
+		{
+			if (this == &rhs)
+				return *this;
+			push_range(std::make_move_iterator(rhs.data.begin()), std::make_move_iterator(rhs.data.end()));
+			rhs.clear();
+			return *this;
+		}
+
+		TopK &operator+=(const TopK &rhs)
+		{
+			return merge(rhs);
+		}
+
+		TopK &operator+=(TopK &&rhs)
+		{
+			return merge(std::move(rhs));
+		}
+
+		// The kept elements from the largest to the smallest
+		Container sorted() const
+		{
+			Container ret(data);
+			heap_type::sort(ret.begin(), ret.end(), key);
+			return ret;
+		}
+
+		// Move out the kept elements from the largest to the smallest, leaves the accumulator empty
+		Container drain()
+		{
+			Container ret(std::move(data));
+			data = Container();
+			data.reserve(k);
+			heap_type::sort(ret.begin(), ret.end(), key);
+			return ret;
+		}
+
+	private:
+		size_t k;
+		Container data;
+		heap_type heap;
+		Key key = nullptr;
+
+		template<typename T>
+		void _push_back(T &&v)
+		{
+			data.push_back(std::forward<T>(v));
+			heap.reset(data.begin(), data.end());
+			heap.heapify_up(data.end() - 1);
+		}
+
+		template<typename T>
+		void _replace_top(T &&v)
+		{
+			data.front() = std::forward<T>(v);
+			heap.reset(data.begin(), data.end());
+			heap.heapify_down(data.begin());
+		}
+	};
+
+
+	template<typename KeyT, typename ValT>
+	class RadixHeap
+	{	// monotone min priority queue for integer keys,
+		// the popped keys must never decrease, O(lgC) amortized time per operation.
+		// keys are bucketed by the highest bit differing from the last popped key.
+	public:
+		using key_type = KeyT;
+		using mapped_type = ValT;
+		using value_type = std::pair<key_type, mapped_type>;
+
+	private:
+		static_assert(std::is_integral_v<key_type>, "RadixHeap needs an integral key type");
+		using ukey_type = std::make_unsigned_t<key_type>;
+		static constexpr size_t BUCKETS = sizeof(key_type) * 8 + 1;
+
+	public:
+		RadixHeap()
+			: _Last(std::numeric_limits<key_type>::min()), _Size(0)
+		{	// signed keys may start negative, flipping the sign bit of both sides keeps the order
+			// so the XOR bucketing still holds
+		}
+
+		size_t size() const { return _Size; }
+
+		bool empty() const { return _Size == 0; }
+
+		// The last popped key, every inserted key must not be less than it
+		key_type last() const { return _Last; }
+
+		void insert(key_type key, const mapped_type &value)
+		{
+			_ensureMonotone(key);
+			_Buckets[_bucket(key)].emplace_back(key, value);
+			_Size++;
+		}
+
+		void insert(key_type key, mapped_type &&value)
+		{
+			_ensureMonotone(key);
+			_Buckets[_bucket(key)].emplace_back(key, std::move(value));
+			_Size++;
+		}
+
+		template<typename... Types>
+		void emplace(key_type key, Types&&... args)
+		{
+			_ensureMonotone(key);
+			_Buckets[_bucket(key)].emplace_back(std::piecewise_construct,
+				std::forward_as_tuple(key), std::forward_as_tuple(std::forward<Types>(args)...));
+			_Size++;
+		}
+
+		const value_type &get()
+		{
+			_pull();
+			return _Buckets[0].back();
+		}
+
+		value_type pop()
+		{
+			_pull();
+			value_type ret = std::move(_Buckets[0].back());
+			_Buckets[0].pop_back();
+			_Size--;
+			return ret;
+		}
+
+		void clear()
+		{
+			for (auto &b : _Buckets)
+				b.clear();
+			_Last = std::numeric_limits<key_type>::min();
+			_Size = 0;
+		}
+
+	private:
+		std::vector<value_type> _Buckets[BUCKETS];
+		key_type _Last;
+		size_t _Size;
+
+		static size_t _bit_width(ukey_type x)
+		{
+			size_t n = 0;
+			for (size_t s = sizeof(ukey_type) * 4; s; s >>= 1)
+			{
+				if (x >> s)
+				{
+					x >>= s;
+					n += s;
+				}
+			}
+			return n + (x != 0);
+		}
+
+		INLINE size_t _bucket(key_type key) const
+		{
+			return _bit_width(static_cast<ukey_type>(key) ^ static_cast<ukey_type>(_Last));
+		}
+
+		void _ensureMonotone(key_type key) const
+		{
+			if (key < _Last)
+				throw std::runtime_error("The key is less than the last popped key");
+		}
+
+		void _pull()
+		{	// Make sure bucket 0 holds the minimum key.
+			if (!_Size)
+				throw std::runtime_error("pop from empty heap");
+			if (!_Buckets[0].empty())
+				return;
+			size_t i = 1;
+			while (_Buckets[i].empty())
+				i++;
+			auto &b = _Buckets[i];
+			auto it = b.begin(), m = it;
+			while (++it != b.end())
+			{
+				if (it->first < m->first)
+					m = it;
+			}
+			_Last = m->first;
+			for (auto &e : b)
+				_Buckets[_bucket(e.first)].push_back(std::move(e));
+			b.clear();
+		}
+	};
+
+	void test_radix_heap()
+	{
+		using testType = unsigned;
+		using pair_type = std::pair<testType, size_t>;
+
+		const size_t n = 1000000;
+		std::vector<testType> delta(n);
+		for (size_t i = 0; i != n; i++)
+			delta[i] = static_cast<testType>(randint(1000));
+
+		// dijkstra like monotone workload, every pushed key is the last popped key plus a small delta
+		RadixHeap<testType, size_t> rh;
+		unsigned long long sum1 = 0, sum2 = 0;
+		auto t1 = system_clock::now();
+		for (size_t i = 0; i != n / 2; i++)
+			rh.insert(delta[i], i);
+		for (size_t i = n / 2; i != n; i++)
+		{
+			testType last = rh.pop().first;
+			sum1 += last;
+			rh.insert(last + delta[i], i);
+		}
+		while (!rh.empty())
+			sum1 += rh.pop().first;
+		auto t2 = system_clock::now();
+
+		MinPriorityQueue<pair_type> pq;
+		for (size_t i = 0; i != n / 2; i++)
+			pq.insert(pair_type(delta[i], i));
+		for (size_t i = n / 2; i != n; i++)
+		{
+			testType last = pq.pop().first;
+			sum2 += last;
+			pq.insert(pair_type(last + delta[i], i));
+		}
+		while (!pq.empty())
+			sum2 += pq.pop().first;
+		auto t3 = system_clock::now();
+
+		auto d = duration<double>(t2 - t1);
+		cout << "RadixHeap cost: " << d.count() << "\tsum: " << sum1 << endl;
+		d = duration<double>(t3 - t2);
+		cout << "MinPriorityQueue cost: " << d.count() << "\tsum: " << sum2 << endl;
+	}
 }
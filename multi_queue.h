@@ -0,0 +1,310 @@
+#pragma once
+#include <atomic>
+#include <thread>
+#include <memory>
+#include <random>
+#include <vector>
+#include "heap.h"
+
+
+
+namespace lyf
+{
+	class _SpinLock
+	{	// test-and-set lock, cheap enough for one per shard
+	public:
+		_SpinLock() noexcept
+		{
+		}
+
+		_SpinLock(const _SpinLock &) = delete;
+		_SpinLock &operator=(const _SpinLock &) = delete;
+
+		INLINE bool try_lock() noexcept
+		{
+			return !_Flag.test_and_set(std::memory_order_acquire);
+		}
+
+		INLINE void lock() noexcept
+		{
+			while (_Flag.test_and_set(std::memory_order_acquire))
+				std::this_thread::yield();
+		}
+
+		INLINE void unlock() noexcept
+		{
+			_Flag.clear(std::memory_order_release);
+		}
+
+	private:
+		std::atomic_flag _Flag = ATOMIC_FLAG_INIT;
+	};
+
+
+	template<typename HeapType,
+		typename Ele,
+		typename Key = void*,
+		typename Container = std::vector<Ele>>
+	class BaseMultiQueue
+	{	// relaxed concurrent priority queue,
+		// c * threads BasePriorityQueue shards, each guarded by its own lock.
+		// insert goes to a random shard, pop takes the better top of two random shards,
+		// so the popped element's rank error is O(shards) in expectation.
+	private:
+		using queue_type = BasePriorityQueue<HeapType, Ele, Key, Container>;
+
+		struct alignas(64) _Shard
+		{
+			explicit _Shard(Key key)
+				: lock(), queue(key)
+			{
+			}
+
+			_SpinLock lock;
+			queue_type queue;
+		};
+
+	public:
+		using value_type = Ele;
+
+		explicit BaseMultiQueue(size_t threads = std::thread::hardware_concurrency(),
+			size_t c = 2, Key key = nullptr)
+			: _ShardCount(std::max<size_t>(threads, 1) * std::max<size_t>(c, 1)),
+			_Shards(), _Size(0), _Key(key)
+		{
+			_Shards.reserve(_ShardCount);
+			for (size_t i = 0; i != _ShardCount; i++)
+				_Shards.emplace_back(new _Shard(key));
+		}
+
+		BaseMultiQueue(const BaseMultiQueue &) = delete;
+		BaseMultiQueue &operator=(const BaseMultiQueue &) = delete;
+
+		size_t shards() const noexcept
+		{
+			return _ShardCount;
+		}
+
+		// number of elements, only exact when no other thread is modifying the queue
+		size_t size() const noexcept
+		{
+			return _Size.load(std::memory_order_relaxed);
+		}
+
+		bool empty() const noexcept
+		{
+			return size() == 0;
+		}
+
+		void insert(const value_type &value)
+		{
+			_Shard &s = _lock_random_shard();
+			s.queue.insert(value);
+			_Size.fetch_add(1, std::memory_order_relaxed);
+			s.lock.unlock();
+		}
+
+		void insert(value_type &&value)
+		{
+			_Shard &s = _lock_random_shard();
+			s.queue.insert(std::move(value));
+			_Size.fetch_add(1, std::memory_order_relaxed);
+			s.lock.unlock();
+		}
+
+		template<typename... Types>
+		void emplace(Types&&... args)
+		{
+			_Shard &s = _lock_random_shard();
+			s.queue.emplace(std::forward<Types>(args)...);
+			_Size.fetch_add(1, std::memory_order_relaxed);
+			s.lock.unlock();
+		}
+
+		// Pop an element close to the top into out,
+		// returns false only if every shard was seen empty
+		bool try_pop(value_type &out)
+		{
+			for (size_t attempt = 0; attempt != _ShardCount; attempt++)
+			{
+				if (empty())
+					return false;
+				size_t i = _random_index(), j = _random_index();
+				_Shard &a = *_Shards[i];
+				if (!a.lock.try_lock())
+					continue;
+				_Shard *pBest = a.queue.empty() ? nullptr : &a;
+				_Shard *pOther = nullptr;
+				if (j != i && _Shards[j]->lock.try_lock())
+				{
+					pOther = _Shards[j].get();
+					if (!pOther->queue.empty() && (!pBest || _better(pOther->queue.get(), pBest->queue.get())))
+						pBest = pOther;
+				}
+				if (pBest)
+					out = pBest->queue.pop();
+				if (pOther)
+					pOther->lock.unlock();
+				a.lock.unlock();
+				if (pBest)
+				{
+					_Size.fetch_sub(1, std::memory_order_relaxed);
+					return true;
+				}
+			}
+			return _pop_any(out);
+		}
+
+		value_type pop()
+		{
+			value_type ret;
+			if (!try_pop(ret))
+				throw std::runtime_error("pop from empty queue");
+			return ret;
+		}
+
+		void clear()
+		{
+			for (size_t i = 0; i != _ShardCount; i++)
+			{
+				_Shard &s = *_Shards[i];
+				s.lock.lock();
+				_Size.fetch_sub(s.queue.size(), std::memory_order_relaxed);
+				s.queue.clear();
+				s.lock.unlock();
+			}
+		}
+
+	private:
+		size_t const _ShardCount;
+		std::vector<std::unique_ptr<_Shard>> _Shards;
+		std::atomic<size_t> _Size;
+		Key _Key;
+
+		INLINE bool _better(const value_type &lhs, const value_type &rhs) const
+		{
+			return _Heap_traits<HeapType, const value_type*, Key>::compare(&lhs, &rhs, _Key);
+		}
+
+		static size_t _random_index(size_t n)
+		{
+			thread_local std::minstd_rand gen(static_cast<unsigned>(
+				std::hash<std::thread::id>()(std::this_thread::get_id())));
+			return gen() % n;
+		}
+
+		INLINE size_t _random_index() const
+		{
+			return _random_index(_ShardCount);
+		}
+
+		_Shard &_lock_random_shard()
+		{
+			while (1)
+			{
+				_Shard &s = *_Shards[_random_index()];
+				if (s.lock.try_lock())
+					return s;
+			}
+		}
+
+		bool _pop_any(value_type &out)
+		{	// slow path, sweep all shards from a random start
+			size_t start = _random_index();
+			for (size_t k = 0; k != _ShardCount; k++)
+			{
+				_Shard &s = *_Shards[(start + k) % _ShardCount];
+				s.lock.lock();
+				if (!s.queue.empty())
+				{
+					out = s.queue.pop();
+					s.lock.unlock();
+					_Size.fetch_sub(1, std::memory_order_relaxed);
+					return true;
+				}
+				s.lock.unlock();
+			}
+			return false;
+		}
+	};
+
+
+	template<typename Ele,
+		typename Key = void*,
+		typename Container = std::vector<Ele>>
+	using MaxMultiQueue = BaseMultiQueue<_HeapMax, Ele, Key, Container>;
+
+	template<typename Ele,
+		typename Key = void*,
+		typename Container = std::vector<Ele>>
+	using MinMultiQueue = BaseMultiQueue<_HeapMin, Ele, Key, Container>;
+
+	void test_multi_queue(size_t threads = std::thread::hardware_concurrency())
+	{
+		using testType = int;
+
+		const size_t n = 1000000;
+		threads = std::max<size_t>(threads, 1);
+		for (size_t t = 1; t <= threads; t++)
+		{	// throughput, every thread alternates insert and pop on a prefilled queue
+			MinMultiQueue<testType> q(t);
+			for (size_t i = 0; i != n; i++)
+				q.insert(static_cast<testType>(i));
+			const size_t ops = n / t;
+			std::vector<std::thread> workers;
+			auto t1 = system_clock::now();
+			for (size_t w = 0; w != t; w++)
+			{
+				workers.emplace_back([&q, ops, w]()
+				{
+					std::minstd_rand gen(static_cast<unsigned>(w + 1));
+					testType v;
+					for (size_t i = 0; i != ops; i++)
+					{
+						if (i & 1)
+							q.try_pop(v);
+						else
+							q.insert(static_cast<testType>(gen() % n));
+					}
+				});
+			}
+			for (auto &th : workers)
+				th.join();
+			auto t2 = system_clock::now();
+			auto d = duration<double>(t2 - t1);
+
+			// rank error, a single consumer drains a shuffled permutation of [0, n),
+			// the error of a pop is the number of smaller keys still in the queue
+			MinMultiQueue<testType> r(t);
+			std::vector<testType> keys(n);
+			for (size_t i = 0; i != n; i++)
+				keys[i] = static_cast<testType>(i);
+			std::shuffle(keys.begin(), keys.end(), std::minstd_rand(1));
+			for (auto k : keys)
+				r.insert(k);
+			std::vector<size_t> present(n + 1, 0);	// fenwick tree over the remaining keys
+			for (size_t i = 1; i <= n; i++)
+			{
+				present[i]++;
+				if (i + (i & (0 - i)) <= n)
+					present[i + (i & (0 - i))] += present[i];
+			}
+			double sum = 0;
+			size_t max = 0;
+			for (size_t i = 0; i != n; i++)
+			{
+				size_t k = static_cast<size_t>(r.pop()), rank = 0;
+				for (size_t j = k; j; j -= j & (0 - j))
+					rank += present[j];
+				for (size_t j = k + 1; j <= n; j += j & (0 - j))
+					present[j]--;
+				sum += rank;
+				max = std::max(max, rank);
+			}
+
+			cout << "threads: " << t << "\tshards: " << q.shards() << endl;
+			cout << "ops/s: " << ops * t / d.count() << endl;
+			cout << "rank error mean: " << sum / n << "\tmax: " << max << endl;
+		}
+	}
+}
@@ -0,0 +1,261 @@
+#pragma once
+#include "utils.h"
+#include "heap.h"
+#include "fibonacci_heap.h"
+
+
+
+namespace lyf
+{
+	template<class _Ty>
+	class PairingHeap
+	{	// min heap with the FibonacciHeap interface,
+		// nodes form a left-child right-sibling tree and extract_min uses two-pass pairing
+	private:
+
+		struct Node
+		{
+			using node_ptr = Node *;
+
+			Node(const _Ty &value)
+				: _Value(value), _pChild(nullptr), _pSibling(nullptr)
+			{
+			}
+
+			Node(_Ty &&value)
+				: _Value(std::move(value)), _pChild(nullptr), _pSibling(nullptr)
+			{
+			}
+
+			const _Ty &value() const noexcept
+			{
+				return _Value;
+			}
+
+			_Ty _Value;
+			node_ptr _pChild;
+			node_ptr _pSibling;
+		};
+
+	public:
+		using value_type = _Ty;
+		using node_ptr = typename Node::node_ptr;
+		using value_ptr = std::unique_ptr<_Ty>;
+
+	public:
+		PairingHeap() noexcept
+			: _pRoot(nullptr), _Size(0)
+		{
+		}
+
+		PairingHeap(PairingHeap &&rhs) noexcept
+			: _pRoot(rhs._pRoot), _Size(rhs._Size)
+		{
+			rhs._pRoot = nullptr;
+			rhs._Size = 0;
+		}
+
+		~PairingHeap()
+		{
+			_destroy();
+		}
+
+		PairingHeap &operator=(PairingHeap &&rhs) noexcept
+		{
+			if (this != &rhs)
+			{
+				_destroy();
+				_pRoot = rhs._pRoot;
+				_Size = rhs._Size;
+				rhs._pRoot = nullptr;
+				rhs._Size = 0;
+			}
+			return *this;
+		}
+
+		PairingHeap(const PairingHeap &) = delete;
+		PairingHeap &operator=(const PairingHeap &) = delete;
+		PairingHeap &operator+=(const PairingHeap &rhs) = delete;
+
+		PairingHeap &operator+=(PairingHeap &&rhs) noexcept
+		{
+			if (this != &rhs)
+			{
+				_pRoot = _meld(_pRoot, rhs._pRoot);
+				_Size += rhs._Size;
+				rhs._pRoot = nullptr;
+				rhs._Size = 0;
+			}
+			return *this;
+		}
+
+		PairingHeap &merge(PairingHeap &&rhs) noexcept
+		{
+			return (*this) += std::move(rhs);
+		}
+
+		void insert(const value_type &value)
+		{
+			_pRoot = _meld(_pRoot, new Node(value));
+			_Size++;
+		}
+
+		void insert(value_type &&value)
+		{
+			_pRoot = _meld(_pRoot, new Node(std::move(value)));
+			_Size++;
+		}
+
+		value_ptr extract_min()
+		{
+			node_ptr np = _pRoot;
+			value_ptr ret = nullptr;
+			if (np)
+			{
+				_pRoot = _two_pass(np->_pChild);
+				_Size--;
+				ret.reset(new _Ty(std::move(np->_Value)));
+				delete np;
+			}
+			return ret;
+		}
+
+		size_t size() const noexcept
+		{
+			return _Size;
+		}
+
+		bool empty() const noexcept
+		{
+			return _Size == 0;
+		}
+
+		const value_type &minimum() const noexcept
+		{
+			return _pRoot->value();
+		}
+
+		void clear() noexcept
+		{
+			_destroy();
+		}
+
+	private:
+		node_ptr _pRoot;
+		size_t _Size;
+
+		static node_ptr _meld(node_ptr a, node_ptr b) noexcept
+		{	// link two roots, the larger one becomes the first child of the smaller one
+			if (!a)
+				return b;
+			if (!b)
+				return a;
+			if (b->value() < a->value())
+				std::swap(a, b);
+			b->_pSibling = a->_pChild;
+			a->_pChild = b;
+			return a;
+		}
+
+		static node_ptr _two_pass(node_ptr first) noexcept
+		{
+			if (!first)
+				return nullptr;
+			// first pass, meld siblings in pairs from left to right,
+			// chaining the results in reverse order
+			node_ptr pairs = nullptr;
+			while (first)
+			{
+				node_ptr a = first, b = first->_pSibling;
+				first = b ? b->_pSibling : nullptr;
+				a->_pSibling = nullptr;
+				if (b)
+					b->_pSibling = nullptr;
+				node_ptr m = _meld(a, b);
+				m->_pSibling = pairs;
+				pairs = m;
+			}
+			// second pass, meld the pairs from right to left
+			node_ptr root = pairs;
+			pairs = pairs->_pSibling;
+			root->_pSibling = nullptr;
+			while (pairs)
+			{
+				node_ptr next = pairs->_pSibling;
+				pairs->_pSibling = nullptr;
+				root = _meld(root, pairs);
+				pairs = next;
+			}
+			return root;
+		}
+
+		void _destroy() noexcept
+		{	// rotate children up into the sibling chain so no recursion is needed
+			node_ptr np = _pRoot;
+			while (np)
+			{
+				if (np->_pChild)
+				{
+					node_ptr cp = np->_pChild;
+					np->_pChild = cp->_pSibling;
+					cp->_pSibling = np;
+					np = cp;
+				}
+				else
+				{
+					node_ptr next = np->_pSibling;
+					delete np;
+					np = next;
+				}
+			}
+			_pRoot = nullptr;
+			_Size = 0;
+		}
+	};
+
+
+	template<class _Ty>
+	inline PairingHeap<_Ty> operator+(PairingHeap<_Ty> &&lhs, PairingHeap<_Ty> &&rhs) noexcept
+	{
+		PairingHeap<_Ty> ret(std::move(lhs));
+		return std::move(ret += std::move(rhs));
+	}
+
+	void test_pairing_heap()
+	{
+		using testType = int;
+
+		const size_t n = 1000000;
+		std::vector<testType> arr(n);
+		for (size_t i = 0; i != n; i++)
+			arr[i] = TestType<testType>::newObj();
+
+		auto run = [&arr](auto &&insert, auto &&extract)
+		{	// fill, then interleave insert with extract_min, then drain
+			long long sum = 0;
+			auto t1 = system_clock::now();
+			for (size_t i = 0; i != n / 2; i++)
+				insert(arr[i]);
+			for (size_t i = n / 2; i != n; i++)
+			{
+				insert(arr[i]);
+				sum += extract();
+			}
+			for (size_t i = 0; i != n / 2; i++)
+				sum += extract();
+			auto t2 = system_clock::now();
+			auto d = duration<double>(t2 - t1);
+			cout << "cost: " << d.count() << "\tsum: " << sum << endl;
+		};
+
+		PairingHeap<testType> ph;
+		FibonacciHeap<testType> fh;
+		MinPriorityQueue<testType> pq;
+		cout << "PairingHeap" << endl;
+		run([&ph](testType v) { ph.insert(v); }, [&ph]() { return *ph.extract_min(); });
+		cout << "FibonacciHeap" << endl;
+		run([&fh](testType v) { fh.insert(v); }, [&fh]() { return *fh.extract_min(); });
+		cout << "MinPriorityQueue" << endl;
+		run([&pq](testType v) { pq.insert(v); }, [&pq]() { return pq.pop(); });
+	}
+}
@@ -0,0 +1,504 @@
+#pragma once
+#include <atomic>
+#include <memory>
+#include <vector>
+#include <iterator>
+#include <memory_resource>
+#include "trees.h"
+#include "skip_list.h"
+
+
+
+namespace lyf
+{
+	template<typename Valt>
+	class PersistentRedBlackTree
+	{	// left-leaning red-black tree with path copying.
+		// a write copies the O(log n) nodes on its path and publishes the new version atomically,
+		// readers take an O(1) snapshot and query it without locks while the writer goes on.
+		// a version is freed once neither the tree nor any snapshot refers to it.
+		// the current version is published through an atomic pointer to a weak reference,
+		// replaced references are reclaimed through the epochs of _EpochDomain.
+		// writes must be serialized by the caller, any thread may take snapshots
+	public:
+		using value_type = Valt;
+
+	private:
+		struct _Node;
+		using link = std::shared_ptr<_Node>;
+
+		struct _Node
+		{
+			_Node(const value_type &v, size_t stamp)
+				: value(v), left(), right(), color(RBTNodeColor::RED), stamp(stamp)
+			{
+			}
+
+			_Node(const _Node &other, size_t stamp)
+				: value(other.value), left(other.left), right(other.right), color(other.color), stamp(stamp)
+			{
+			}
+
+			value_type value;
+			link left;
+			link right;
+			RBTNodeColor color;
+			size_t stamp;	// the write which created the node, only that write may modify it
+		};
+
+		struct _Version
+		{
+			link root;
+			size_t size;
+		};
+
+		using version_ptr = std::shared_ptr<const _Version>;
+		using version_ref = std::weak_ptr<const _Version>;
+
+	public:
+		class const_iterator
+		{	// in-order iterator, valid while the snapshot it came from is alive
+		public:
+			using iterator_category = std::forward_iterator_tag;
+			using value_type = Valt;
+			using difference_type = std::ptrdiff_t;
+			using pointer = const value_type*;
+			using reference = const value_type&;
+
+			const_iterator() = default;
+
+			reference operator*() const
+			{
+				return _Stack.back()->value;
+			}
+
+			pointer operator->() const
+			{
+				return &_Stack.back()->value;
+			}
+
+			const_iterator &operator++()
+			{
+				const _Node *np = _Stack.back();
+				_Stack.pop_back();
+				_push_left(np->right.get());
+				return *this;
+			}
+
+			const_iterator operator++(int)
+			{
+				const_iterator tmp = *this;
+				++*this;
+				return tmp;
+			}
+
+			bool operator==(const const_iterator &rhs) const
+			{
+				return _Stack.empty() ? rhs._Stack.empty() : !rhs._Stack.empty() && _Stack.back() == rhs._Stack.back();
+			}
+
+			bool operator!=(const const_iterator &rhs) const
+			{
+				return !(*this == rhs);
+			}
+
+		private:
+			friend class PersistentRedBlackTree;
+
+			explicit const_iterator(const _Node *np)
+			{
+				_push_left(np);
+			}
+
+			void _push_left(const _Node *np)
+			{
+				for (; np; np = np->left.get())
+					_Stack.push_back(np);
+			}
+
+			std::vector<const _Node*> _Stack;
+		};
+
+		class Snapshot
+		{	// an immutable version of the tree, safe to query from any thread
+		public:
+			Snapshot() = default;
+
+			size_t size() const
+			{
+				return _pVersion ? _pVersion->size : 0;
+			}
+
+			bool empty() const
+			{
+				return size() == 0;
+			}
+
+			// The stored value equal to the argument, nullptr if there is none
+			const value_type *search(const value_type &value) const
+			{
+				const _Node *np = _root();
+				while (np)
+				{
+					if (value < np->value)
+						np = np->left.get();
+					else if (np->value < value)
+						np = np->right.get();
+					else
+						return &np->value;
+				}
+				return nullptr;
+			}
+
+			bool contains(const value_type &value) const
+			{
+				return search(value) != nullptr;
+			}
+
+			// The first value not less than the argument, nullptr if there is none
+			const value_type *lower_bound(const value_type &value) const
+			{
+				const _Node *np = _root(), *ret = nullptr;
+				while (np)
+				{
+					if (np->value < value)
+						np = np->right.get();
+					else
+					{
+						ret = np;
+						np = np->left.get();
+					}
+				}
+				return ret ? &ret->value : nullptr;
+			}
+
+			const value_type &min_value() const
+			{
+				const _Node *np = _nonempty_root();
+				while (np->left)
+					np = np->left.get();
+				return np->value;
+			}
+
+			const value_type &max_value() const
+			{
+				const _Node *np = _nonempty_root();
+				while (np->right)
+					np = np->right.get();
+				return np->value;
+			}
+
+			// The in-order traversal, calling the provided function with each value
+			template<typename Func>
+			void in_order_traversal(Func func) const
+			{
+				for (const value_type &v : *this)
+					func(v);
+			}
+
+			const_iterator begin() const
+			{
+				return const_iterator(_root());
+			}
+
+			const_iterator end() const
+			{
+				return const_iterator();
+			}
+
+			// check the red-black tree property, returns black-height
+			// if the property is false, returns -1
+			int check_property() const
+			{
+				const _Node *np = _root();
+				if (np && np->color != RBTNodeColor::BLACK)
+					return -1;
+				return _check_property_recursive(np);
+			}
+
+		private:
+			friend class PersistentRedBlackTree;
+
+			explicit Snapshot(version_ptr pVersion)
+				: _pVersion(std::move(pVersion))
+			{
+			}
+
+			const _Node *_root() const
+			{
+				return _pVersion ? _pVersion->root.get() : nullptr;
+			}
+
+			const _Node *_nonempty_root() const
+			{
+				if (empty())
+					throw std::runtime_error("The tree is empty");
+				return _root();
+			}
+
+			static int _check_property_recursive(const _Node *np)
+			{
+				if (!np)
+					return 0;
+				if (np->color == RBTNodeColor::RED && (_is_red(np->left) || _is_red(np->right)))
+					return -1;
+				if ((np->left && np->value < np->left->value) || (np->right && np->right->value < np->value))
+					return -1;
+				int lh = _check_property_recursive(np->left.get());
+				int rh = _check_property_recursive(np->right.get());
+				if (lh != rh || lh == -1)
+					return -1;
+				return lh + (np->color == RBTNodeColor::BLACK);
+			}
+
+			version_ptr _pVersion;
+		};
+
+		explicit PersistentRedBlackTree(std::pmr::memory_resource *pResource = std::pmr::get_default_resource())
+			: _pResource(pResource), _pVersion(), _pCurrent(nullptr), _Stamp(0)
+		{
+		}
+
+		~PersistentRedBlackTree()
+		{
+			delete _pCurrent.load(std::memory_order_relaxed);
+		}
+
+		template<typename Iter>
+		PersistentRedBlackTree(Iter begin, Iter end,
+			std::pmr::memory_resource *pResource = std::pmr::get_default_resource())
+			: PersistentRedBlackTree(pResource)
+		{
+			for (; begin != end; ++begin)
+				this->insert(*begin);
+		}
+
+		PersistentRedBlackTree(const PersistentRedBlackTree &) = delete;
+		PersistentRedBlackTree &operator=(const PersistentRedBlackTree &) = delete;
+
+		// The resource the nodes are allocated from, it must be thread-safe
+		// since the last reader of a version frees its nodes
+		std::pmr::memory_resource *get_resource() const
+		{
+			return _pResource;
+		}
+
+		// The current version, O(1) and lock-free
+		Snapshot snapshot() const
+		{
+			_EpochGuard guard;
+			for (;;)
+			{
+				version_ref *pRef = _pCurrent.load(std::memory_order_acquire);
+				if (!pRef)
+					return Snapshot();
+				if (version_ptr pVersion = pRef->lock())
+					return Snapshot(std::move(pVersion));
+				// a newer version replaced it after the load, read again
+			}
+		}
+
+		size_t size() const
+		{
+			return snapshot().size();
+		}
+
+		bool empty() const
+		{
+			return size() == 0;
+		}
+
+		void insert(const value_type &value)
+		{
+			version_ptr pVersion = _pVersion;
+			link root = pVersion ? pVersion->root : link();
+			size_t size = pVersion ? pVersion->size : 0;
+			_Stamp++;
+			root = this->_insert(root, value);
+			this->_own(root)->color = RBTNodeColor::BLACK;
+			this->_publish(std::move(root), size + 1);
+		}
+
+		// Remove one value equal to the argument, returns whether there was one
+		bool remove(const value_type &value)
+		{
+			version_ptr pVersion = _pVersion;
+			if (!Snapshot(pVersion).contains(value))
+				return false;
+			link root = pVersion->root;
+			_Stamp++;
+			if (!_is_red(root->left) && !_is_red(root->right))
+				this->_own(root)->color = RBTNodeColor::RED;
+			root = this->_remove(root, value);
+			if (root)
+				this->_own(root)->color = RBTNodeColor::BLACK;
+			this->_publish(std::move(root), pVersion->size - 1);
+			return true;
+		}
+
+		void clear()
+		{
+			this->_publish(version_ptr());
+		}
+
+	private:
+		std::pmr::memory_resource *_pResource;
+		version_ptr _pVersion;	// the current version, only touched by the writer
+		std::atomic<version_ref*> _pCurrent;	// what readers load, nullptr when empty
+		size_t _Stamp;
+
+		static INLINE bool _is_red(const link &np)
+		{
+			return np && np->color == RBTNodeColor::RED;
+		}
+
+		static INLINE RBTNodeColor _flip(RBTNodeColor color)
+		{
+			return color == RBTNodeColor::RED ? RBTNodeColor::BLACK : RBTNodeColor::RED;
+		}
+
+		void _publish(link root, size_t size)
+		{	// the version lives on the global heap, a retired weak reference may outlive the resource
+			this->_publish(std::make_shared<const _Version>(_Version{ std::move(root), size }));
+		}
+
+		void _publish(version_ptr pVersion)
+		{	// swap in the new reference before dropping the old version, a reader whose
+			// lock fails then finds the new one
+			version_ref *pOld = _pCurrent.exchange(pVersion ? new version_ref(pVersion) : nullptr,
+				std::memory_order_acq_rel);
+			_pVersion = std::move(pVersion);
+			if (pOld)
+				_EpochDomain::instance().retire(pOld, [](void *p) { delete static_cast<version_ref*>(p); });
+		}
+
+		_Node *_own(link &np)
+		{	// copy the node unless the current write created it, published nodes are never modified
+			if (np->stamp != _Stamp)
+				np = std::allocate_shared<_Node>(std::pmr::polymorphic_allocator<_Node>(_pResource), *np, _Stamp);
+			return np.get();
+		}
+
+		link _rotate_left(link h)
+		{
+			this->_own(h);
+			link x = h->right;
+			this->_own(x);
+			h->right = x->left;
+			x->color = h->color;
+			h->color = RBTNodeColor::RED;
+			x->left = std::move(h);
+			return x;
+		}
+
+		link _rotate_right(link h)
+		{
+			this->_own(h);
+			link x = h->left;
+			this->_own(x);
+			h->left = x->right;
+			x->color = h->color;
+			h->color = RBTNodeColor::RED;
+			x->right = std::move(h);
+			return x;
+		}
+
+		void _flip_colors(link &h)
+		{
+			_Node *np = this->_own(h);
+			np->color = _flip(np->color);
+			this->_own(np->left)->color = _flip(np->left->color);
+			this->_own(np->right)->color = _flip(np->right->color);
+		}
+
+		link _balance(link h)
+		{
+			if (_is_red(h->right) && !_is_red(h->left))
+				h = this->_rotate_left(std::move(h));
+			if (_is_red(h->left) && _is_red(h->left->left))
+				h = this->_rotate_right(std::move(h));
+			if (_is_red(h->left) && _is_red(h->right))
+				this->_flip_colors(h);
+			return h;
+		}
+
+		link _insert(link h, const value_type &value)
+		{
+			if (!h)
+				return std::allocate_shared<_Node>(std::pmr::polymorphic_allocator<_Node>(_pResource), value, _Stamp);
+			_Node *np = this->_own(h);
+			if (value < np->value)
+				np->left = this->_insert(np->left, value);
+			else
+				np->right = this->_insert(np->right, value);
+			return this->_balance(std::move(h));
+		}
+
+		link _move_red_left(link h)
+		{	// make the left child or one of its children red
+			this->_flip_colors(h);
+			if (_is_red(h->right->left))
+			{
+				h->right = this->_rotate_right(h->right);
+				h = this->_rotate_left(std::move(h));
+				this->_flip_colors(h);
+			}
+			return h;
+		}
+
+		link _move_red_right(link h)
+		{	// make the right child or one of its children red
+			this->_flip_colors(h);
+			if (_is_red(h->left->left))
+			{
+				h = this->_rotate_right(std::move(h));
+				this->_flip_colors(h);
+			}
+			return h;
+		}
+
+		link _remove_min(link h)
+		{
+			if (!h->left)
+				return link();
+			this->_own(h);
+			if (!_is_red(h->left) && !_is_red(h->left->left))
+				h = this->_move_red_left(std::move(h));
+			h->left = this->_remove_min(h->left);
+			return this->_balance(std::move(h));
+		}
+
+		link _remove(link h, const value_type &value)
+		{	// the value is known to be in the subtree h.
+			// a rotation moves the entry node into the right subtree, where an equal value
+			// pulled up from the left must not be taken for it
+			const _Node *entry = this->_own(h);
+			if (value < h->value)
+			{
+				if (!_is_red(h->left) && !_is_red(h->left->left))
+					h = this->_move_red_left(std::move(h));
+				h->left = this->_remove(h->left, value);
+			}
+			else
+			{
+				if (_is_red(h->left))
+					h = this->_rotate_right(std::move(h));
+				if (h.get() == entry && !(h->value < value) && !h->right)
+					return link();
+				if (!_is_red(h->right) && !_is_red(h->right->left))
+					h = this->_move_red_right(std::move(h));
+				if (h.get() == entry && !(h->value < value))
+				{	// replace the value by its successor
+					const _Node *np = h->right.get();
+					while (np->left)
+						np = np->left.get();
+					h->value = np->value;
+					h->right = this->_remove_min(h->right);
+				}
+				else
+					h->right = this->_remove(h->right, value);
+			}
+			return this->_balance(std::move(h));
+		}
+	};
+}
@@ -0,0 +1,590 @@
+#pragma once
+#include <atomic>
+#include <thread>
+#include <random>
+#include <vector>
+#include <cstdint>
+#include <new>
+#include <mutex>
+#include "trees.h"
+
+
+
+namespace lyf
+{
+	class _EpochDomain
+	{	// epoch based reclamation shared by every lock-free container.
+		// a thread pins the global epoch while it reads shared nodes,
+		// a node retired at epoch e is freed once the global epoch reaches e + 2,
+		// by then every thread which could have seen it has left its critical section
+	public:
+		static _EpochDomain &instance()
+		{
+			static _EpochDomain domain;
+			return domain;
+		}
+
+		_EpochDomain(const _EpochDomain &) = delete;
+		_EpochDomain &operator=(const _EpochDomain &) = delete;
+
+		~_EpochDomain()
+		{
+			_Record *pRec = _pRecords.load();
+			while (pRec)
+			{
+				_Record *pNext = pRec->pNext;
+				for (_Bag &bag : pRec->bags)
+					_free_bag(bag);
+				delete pRec;
+				pRec = pNext;
+			}
+		}
+
+		void enter()
+		{
+			_Record &rec = _local();
+			if (rec.nesting++ == 0)
+			{
+				rec.epoch.store(_Global.load() << 1 | ACTIVE);
+				std::atomic_thread_fence(std::memory_order_seq_cst);
+			}
+		}
+
+		void leave()
+		{
+			_Record &rec = _local();
+			if (--rec.nesting == 0)
+				rec.epoch.store(0, std::memory_order_release);
+		}
+
+		// Free p with deleter once no thread can still be reading it,
+		// p must already be unreachable from the shared structure
+		void retire(void *p, void(*deleter)(void*))
+		{
+			_Record &rec = _local();
+			uint64_t e = _Global.load();
+			_Bag &bag = rec.bags[e % 3];
+			if (bag.epoch != e)
+			{	// the bag was filled at e - 3 or earlier
+				_free_bag(bag);
+				bag.epoch = e;
+			}
+			bag.garbage.push_back({ p, deleter });
+			if (++rec.retired % ADVANCE_INTERVAL == 0 && this->_try_advance(e))
+			{
+				_Bag &old = rec.bags[(e + 1) % 3];
+				if (old.epoch + 2 <= e)
+					_free_bag(old);
+			}
+		}
+
+	private:
+		static constexpr uint64_t ACTIVE = 1;
+		static constexpr size_t ADVANCE_INTERVAL = 64;
+
+		struct _Retired
+		{
+			void *p;
+			void(*deleter)(void*);
+		};
+
+		struct _Bag
+		{
+			uint64_t epoch = 0;
+			std::vector<_Retired> garbage;
+		};
+
+		struct alignas(64) _Record
+		{
+			std::atomic<uint64_t> epoch{ 0 };	// pinned epoch << 1 | ACTIVE, 0 outside a critical section
+			std::atomic<bool> inUse{ true };
+			_Record *pNext = nullptr;
+			size_t nesting = 0;
+			size_t retired = 0;
+			_Bag bags[3];
+		};
+
+		class _ThreadRecord
+		{	// a thread's record, handed back to the domain with its pending garbage when the thread exits
+		public:
+			_ThreadRecord(_EpochDomain &domain)
+				: _pRec(domain._acquire())
+			{
+			}
+
+			~_ThreadRecord()
+			{
+				_pRec->inUse.store(false, std::memory_order_release);
+			}
+
+			_Record *_pRec;
+		};
+
+		std::atomic<uint64_t> _Global{ 1 };
+		std::atomic<_Record*> _pRecords{ nullptr };
+
+		_EpochDomain()
+		{
+		}
+
+		_Record &_local()
+		{
+			thread_local _ThreadRecord tr(*this);
+			return *tr._pRec;
+		}
+
+		_Record *_acquire()
+		{
+			for (_Record *pRec = _pRecords.load(); pRec; pRec = pRec->pNext)
+			{
+				bool expected = false;
+				if (!pRec->inUse.load(std::memory_order_relaxed) && pRec->inUse.compare_exchange_strong(expected, true))
+					return pRec;
+			}
+			_Record *pRec = new _Record;
+			pRec->pNext = _pRecords.load();
+			while (!_pRecords.compare_exchange_weak(pRec->pNext, pRec))
+				;
+			return pRec;
+		}
+
+		bool _try_advance(uint64_t &e)
+		{	// advance the global epoch past e if every active thread has pinned it,
+			// e becomes the new global epoch
+			for (_Record *pRec = _pRecords.load(); pRec; pRec = pRec->pNext)
+			{
+				uint64_t pinned = pRec->epoch.load();
+				if ((pinned & ACTIVE) && (pinned >> 1) != e)
+					return false;
+			}
+			uint64_t expected = e;
+			if (_Global.compare_exchange_strong(expected, e + 1))
+				e++;
+			else
+				e = expected;
+			return true;
+		}
+
+		static void _free_bag(_Bag &bag)
+		{
+			for (const _Retired &r : bag.garbage)
+				r.deleter(r.p);
+			bag.garbage.clear();
+		}
+	};
+
+
+	class _EpochGuard
+	{	// pins the current epoch for the lifetime of the guard, guards nest
+	public:
+		_EpochGuard()
+		{
+			_EpochDomain::instance().enter();
+		}
+
+		~_EpochGuard()
+		{
+			_EpochDomain::instance().leave();
+		}
+
+		_EpochGuard(const _EpochGuard &) = delete;
+		_EpochGuard &operator=(const _EpochGuard &) = delete;
+	};
+
+
+	template<typename Valt>
+	class ConcurrentSkipList
+	{	// lock-free ordered set, Fraser's skip list with Harris' marked next pointers.
+		// a node is deleted by marking its next pointers top-down, the level 0 mark is
+		// the linearization point, and traversals snip marked nodes out.
+		// values are copied out since a node may be freed once the call returns,
+		// unlike RedBlackTree equal values are not stored twice
+	public:
+		using value_type = Valt;
+
+	private:
+		static constexpr int MAX_LEVEL = 32;
+		static constexpr uintptr_t MARK = 1;
+
+		struct _Node
+		{
+			value_type value;
+			std::atomic<int> refs;	// one for the inserter still linking, one for the node being in the set
+			int height;
+			std::atomic<uintptr_t> next[1];	// height pointers, allocated past the end
+		};
+
+		static INLINE _Node *_ptr(uintptr_t link)
+		{
+			return reinterpret_cast<_Node*>(link & ~MARK);
+		}
+
+		static INLINE bool _marked(uintptr_t link)
+		{
+			return (link & MARK) != 0;
+		}
+
+		static INLINE uintptr_t _link(_Node *np)
+		{
+			return reinterpret_cast<uintptr_t>(np);
+		}
+
+	public:
+		ConcurrentSkipList()
+			: _pHead(_alloc_node(MAX_LEVEL)), _Size(0)
+		{
+		}
+
+		template<typename Iter>
+		ConcurrentSkipList(Iter begin, Iter end)
+			: ConcurrentSkipList()
+		{
+			for (; begin != end; ++begin)
+				this->insert(*begin);
+		}
+
+		ConcurrentSkipList(const ConcurrentSkipList &) = delete;
+		ConcurrentSkipList &operator=(const ConcurrentSkipList &) = delete;
+
+		~ConcurrentSkipList()
+		{	// no other thread may use the list any more, removed nodes belong to the epoch domain
+			_Node *np = _ptr(_pHead->next[0].load(std::memory_order_relaxed));
+			while (np)
+			{
+				_Node *pNext = _ptr(np->next[0].load(std::memory_order_relaxed));
+				_free_node(np);
+				np = pNext;
+			}
+			::operator delete(_pHead);
+		}
+
+		// number of values, only exact when no other thread is modifying the list
+		size_t size() const
+		{
+			return _Size.load(std::memory_order_relaxed);
+		}
+
+		bool empty() const
+		{
+			return size() == 0;
+		}
+
+		// Insert the value, returns false if an equal value is already in the list
+		bool insert(const value_type &value)
+		{
+			_EpochGuard guard;
+			_Node *preds[MAX_LEVEL], *succs[MAX_LEVEL];
+			int height = _random_height();
+			_Node *np = nullptr;
+			while (true)
+			{
+				if (this->_find(value, preds, succs))
+				{
+					if (np)
+						_free_node(np);
+					return false;
+				}
+				if (!np)
+					np = _new_node(value, height);
+				for (int i = 0; i != height; i++)
+					np->next[i].store(_link(succs[i]), std::memory_order_relaxed);
+				uintptr_t expected = _link(succs[0]);
+				if (preds[0]->next[0].compare_exchange_strong(expected, _link(np)))
+					break;
+			}
+			_Size.fetch_add(1, std::memory_order_relaxed);
+			this->_link_levels(np, preds, succs);
+			return true;
+		}
+
+		// Remove the value, returns whether it was in the list
+		bool erase(const value_type &value)
+		{
+			_EpochGuard guard;
+			_Node *preds[MAX_LEVEL], *succs[MAX_LEVEL];
+			if (!this->_find(value, preds, succs))
+				return false;
+			_Node *np = succs[0];
+			for (int i = np->height - 1; i > 0; i--)
+			{
+				uintptr_t link = np->next[i].load();
+				while (!_marked(link) && !np->next[i].compare_exchange_weak(link, link | MARK))
+					;
+			}
+			uintptr_t link = np->next[0].load();
+			while (true)
+			{
+				if (_marked(link))
+					return false;	// another thread removed it first
+				if (np->next[0].compare_exchange_weak(link, link | MARK))
+					break;
+			}
+			_Size.fetch_sub(1, std::memory_order_relaxed);
+			this->_find(value, preds, succs);
+			this->_release(np);
+			return true;
+		}
+
+		bool remove(const value_type &value)
+		{
+			return this->erase(value);
+		}
+
+		bool contains(const value_type &value) const
+		{
+			_EpochGuard guard;
+			_Node *np = this->_lower_bound_node(value);
+			return np && !(value < np->value);
+		}
+
+		// Copy the stored value equal to the argument into out, returns whether there is one
+		bool search(const value_type &value, value_type &out) const
+		{
+			_EpochGuard guard;
+			_Node *np = this->_lower_bound_node(value);
+			if (!np || value < np->value)
+				return false;
+			out = np->value;
+			return true;
+		}
+
+		// Copy the first value not less than the argument into out, returns whether there is one
+		bool lower_bound(const value_type &value, value_type &out) const
+		{
+			_EpochGuard guard;
+			_Node *np = this->_lower_bound_node(value);
+			if (!np)
+				return false;
+			out = np->value;
+			return true;
+		}
+
+		// Call func with every value in [lo, hi] in order.
+		// the walk is weakly consistent, it sees every value present for the whole call
+		// and none removed before it started, func must not modify the list
+		template<typename Func>
+		void for_each_in_range(const value_type &lo, const value_type &hi, Func func) const
+		{
+			_EpochGuard guard;
+			for (_Node *np = this->_lower_bound_node(lo); np && !(hi < np->value); np = _next_alive(np))
+				func(np->value);
+		}
+
+		// The in-order traversal, calling the provided function with each value
+		template<typename Func>
+		void in_order_traversal(Func func) const
+		{
+			_EpochGuard guard;
+			for (_Node *np = _next_alive(_pHead); np; np = _next_alive(np))
+				func(np->value);
+		}
+
+	private:
+		_Node *_pHead;
+		std::atomic<size_t> _Size;
+
+		static _Node *_alloc_node(int height)
+		{
+			void *p = ::operator new(sizeof(_Node) + (height - 1) * sizeof(std::atomic<uintptr_t>));
+			_Node *np = static_cast<_Node*>(p);
+			for (int i = 0; i != height; i++)
+				new (&np->next[i]) std::atomic<uintptr_t>(0);
+			np->height = height;
+			return np;
+		}
+
+		static _Node *_new_node(const value_type &value, int height)
+		{
+			_Node *np = _alloc_node(height);
+			try
+			{
+				new (&np->value) value_type(value);
+			}
+			catch (...)
+			{
+				::operator delete(np);
+				throw;
+			}
+			new (&np->refs) std::atomic<int>(2);
+			return np;
+		}
+
+		static void _free_node(void *p)
+		{
+			_Node *np = static_cast<_Node*>(p);
+			np->value.~value_type();
+			::operator delete(np);
+		}
+
+		static int _random_height()
+		{	// geometric with p = 1/4, which keeps the expected number of pointers per node at 4/3
+			thread_local std::minstd_rand gen(static_cast<unsigned>(
+				std::hash<std::thread::id>()(std::this_thread::get_id())));
+			int height = 1;
+			while (height < MAX_LEVEL && (gen() & 3) == 0)
+				height++;
+			return height;
+		}
+
+		static _Node *_next_alive(_Node *np)
+		{	// the next node at level 0 which is not removed
+			_Node *pNext = _ptr(np->next[0].load(std::memory_order_acquire));
+			while (pNext && _marked(pNext->next[0].load(std::memory_order_acquire)))
+				pNext = _ptr(pNext->next[0].load(std::memory_order_acquire));
+			return pNext;
+		}
+
+		_Node *_lower_bound_node(const value_type &value) const
+		{	// the first node not less than value which is not removed, without snipping
+			_Node *pred = _pHead;
+			_Node *curr = nullptr;
+			for (int i = MAX_LEVEL - 1; i >= 0; i--)
+			{
+				curr = _ptr(pred->next[i].load(std::memory_order_acquire));
+				while (curr && curr->value < value)
+				{
+					pred = curr;
+					curr = _ptr(curr->next[i].load(std::memory_order_acquire));
+				}
+			}
+			if (curr && _marked(curr->next[0].load(std::memory_order_acquire)))
+				curr = _next_alive(curr);
+			return curr;
+		}
+
+		bool _find(const value_type &value, _Node **preds, _Node **succs)
+		{	// fill the last node less than value and its successor at each level,
+			// snipping marked nodes on the way, returns whether succs[0] equals value
+		retry:
+			_Node *pred = _pHead;
+			for (int i = MAX_LEVEL - 1; i >= 0; i--)
+			{
+				_Node *curr = _ptr(pred->next[i].load());
+				while (curr)
+				{
+					uintptr_t link = curr->next[i].load();
+					while (_marked(link))
+					{
+						uintptr_t expected = _link(curr);
+						if (!pred->next[i].compare_exchange_strong(expected, _link(_ptr(link))))
+							goto retry;
+						curr = _ptr(link);
+						if (!curr)
+							break;
+						link = curr->next[i].load();
+					}
+					if (!curr || !(curr->value < value))
+						break;
+					pred = curr;
+					curr = _ptr(link);
+				}
+				preds[i] = pred;
+				succs[i] = curr;
+			}
+			return succs[0] && !(value < succs[0]->value);
+		}
+
+		void _link_levels(_Node *np, _Node **preds, _Node **succs)
+		{	// link the upper levels, stops as soon as the node is being removed.
+			// a level linked after the remover's snip is snipped again here,
+			// so the node is unreachable once both sides released it
+			for (int i = 1; i < np->height; i++)
+			{
+				while (true)
+				{
+					uintptr_t link = np->next[i].load();
+					if (_marked(link))
+						goto done;
+					if (_ptr(link) != succs[i] && !np->next[i].compare_exchange_strong(link, _link(succs[i])))
+						continue;
+					uintptr_t expected = _link(succs[i]);
+					if (preds[i]->next[i].compare_exchange_strong(expected, _link(np)))
+						break;
+					this->_find(np->value, preds, succs);
+					if (succs[0] != np)
+						goto done;
+				}
+			}
+		done:
+			if (_marked(np->next[0].load()))
+				this->_find(np->value, preds, succs);
+			this->_release(np);
+		}
+
+		void _release(_Node *np)
+		{
+			if (np->refs.fetch_sub(1) == 1)
+				_EpochDomain::instance().retire(np, &ConcurrentSkipList::_free_node);
+		}
+	};
+
+	void test_concurrent_skip_list(size_t threads = std::thread::hardware_concurrency())
+	{
+		using testType = int;
+
+		const size_t n = 1000000, range = 1 << 16;
+		threads = std::max<size_t>(threads, 1);
+		for (size_t t = 1; t <= threads; t++)
+		{	// half lookups, a quarter inserts and a quarter erases on a half full key range
+			ConcurrentSkipList<testType> list;
+			RedBlackTree<testType> tree;
+			std::mutex mutex;
+			for (size_t i = 0; i < range; i += 2)
+			{
+				list.insert(static_cast<testType>(i));
+				tree.insert(static_cast<testType>(i));
+			}
+			const size_t ops = n / t;
+			auto run = [t, ops, range](auto &&op)
+			{
+				std::vector<std::thread> workers;
+				for (size_t w = 0; w != t; w++)
+				{
+					workers.emplace_back([&op, ops, range, w]()
+					{
+						std::minstd_rand gen(static_cast<unsigned>(w + 1));
+						for (size_t i = 0; i != ops; i++)
+						{
+							unsigned r = gen();
+							op(r & 3, static_cast<testType>((r >> 2) % range));
+						}
+					});
+				}
+				for (auto &th : workers)
+					th.join();
+			};
+
+			auto t1 = system_clock::now();
+			run([&list](unsigned kind, testType v)
+			{
+				if (kind == 0)
+					list.insert(v);
+				else if (kind == 1)
+					list.erase(v);
+				else
+					list.contains(v);
+			});
+			auto t2 = system_clock::now();
+			run([&tree, &mutex](unsigned kind, testType v)
+			{	// RedBlackTree keeps equal values, insert only missing ones to stay a set
+				std::lock_guard<std::mutex> lock(mutex);
+				if (kind == 0)
+				{
+					if (!tree.search(v))
+						tree.insert(v);
+				}
+				else if (kind == 1)
+					tree.remove(v);
+				else
+					tree.search(v);
+			});
+			auto t3 = system_clock::now();
+
+			cout << "threads: " << t << endl;
+			auto d = duration<double>(t2 - t1);
+			cout << "skip list ops/s: " << ops * t / d.count() << endl;
+			d = duration<double>(t3 - t2);
+			cout << "locked tree ops/s: " << ops * t / d.count() << endl;
+		}
+	}
+}
@@ -0,0 +1,368 @@
+#pragma once
+#include <cstdint>
+#include <optional>
+#include <vector>
+#include <memory>
+#include "utils.h"
+#include "heap.h"
+
+
+
+namespace lyf
+{
+	struct TimerHandle
+	{	// identifies a scheduled timer, stays safe to cancel after the timer fired
+		size_t slot = SIZE_MAX;
+		uint64_t gen = 0;
+	};
+
+
+	template<typename T>
+	class TimingWheel
+	{	// hierarchical timing wheel,
+		// O(1) schedule and cancel, timers cascade into finer levels as time advances.
+		// level l has 2^bits buckets, each spanning 2^(bits*l) ticks.
+	public:
+		using value_type = T;
+		using time_type = uint64_t;
+
+	private:
+		static constexpr size_t NIL = SIZE_MAX;
+
+		struct _List
+		{	// FIFO of timer slots, linked through the timers so scheduling never allocates
+			size_t head = NIL;
+			size_t tail = NIL;
+			size_t size = 0;
+		};
+
+		struct _Timer
+		{
+			time_type deadline = 0;
+			std::optional<value_type> payload;
+			uint64_t gen = 0;
+			_List *pList = nullptr;
+			size_t prev = NIL;
+			size_t next = NIL;
+		};
+
+	public:
+		// levels beyond the 64 bits of the tick are dropped, they could never be reached
+		explicit TimingWheel(size_t levels = 4, size_t bits = 8, time_type now = 0)
+			: _Levels(std::min(std::max<size_t>(levels, 1), (63 + _clamp_bits(bits)) / _clamp_bits(bits))),
+			_Bits(_clamp_bits(bits)),
+			_Mask((time_type(1) << _Bits) - 1), _Now(now), _Size(0),
+			_pBuckets(new _List[_Levels << _Bits])
+		{
+		}
+
+		TimingWheel(const TimingWheel &) = delete;
+		TimingWheel &operator=(const TimingWheel &) = delete;
+
+		time_type now() const { return _Now; }
+
+		size_t size() const { return _Size; }
+
+		bool empty() const { return _Size == 0; }
+
+		// Schedule the payload at the absolute tick deadline,
+		// deadlines not after now fire on the next advance
+		TimerHandle schedule(time_type deadline, const value_type &payload)
+		{
+			return _schedule(deadline, payload);
+		}
+
+		TimerHandle schedule(time_type deadline, value_type &&payload)
+		{
+			return _schedule(deadline, std::move(payload));
+		}
+
+		TimerHandle schedule_after(time_type delay, const value_type &payload)
+		{
+			return _schedule(_Now + delay, payload);
+		}
+
+		TimerHandle schedule_after(time_type delay, value_type &&payload)
+		{
+			return _schedule(_Now + delay, std::move(payload));
+		}
+
+		// Returns false if the timer already fired or was canceled
+		bool cancel(TimerHandle h)
+		{
+			if (!_isLive(h))
+				return false;
+			_unlink(h.slot);
+			_release(h.slot);
+			return true;
+		}
+
+		// Move the clock forward to the tick to,
+		// calling func(deadline, payload) for every timer expiring on the way, in tick order.
+		// ticks without a bucket to fire or cascade are skipped
+		template<typename Func>
+		size_t advance(time_type to, Func func)
+		{
+			size_t fired = _fire_list(_Due, func);
+			if (to <= _Now)
+				return fired;
+			while (_Now != to)
+			{
+				if (empty())
+				{
+					_Now = to;
+					break;
+				}
+				if (!_Due.size)
+				{	// nothing happens on the ticks before the next event, skip them
+					time_type next = _next_event();
+					_Now = (next < to ? next : to) - 1;
+				}
+				_Now++;
+				_cascade();
+				fired += _fire_list(_Due, func);
+				fired += _fire_list(_bucket(0, _Now & _Mask), func);
+			}
+			return fired;
+		}
+
+		template<typename Func>
+		size_t advance_by(time_type ticks, Func func)
+		{
+			return advance(_Now + ticks, func);
+		}
+
+		void clear()
+		{
+			for (size_t i = 0; i != (_Levels << _Bits); i++)
+				_clear_list(_pBuckets[i]);
+			_clear_list(_Due);
+			_clear_list(_Overflow);
+		}
+
+	private:
+		size_t const _Levels;
+		size_t const _Bits;
+		time_type const _Mask;
+		time_type _Now;
+		size_t _Size;
+		std::unique_ptr<_List[]> _pBuckets;
+		_List _Due;
+		_List _Overflow;
+		std::vector<_Timer> _Timers;
+		std::vector<size_t> _Free;
+
+		INLINE _List &_bucket(size_t level, time_type index)
+		{
+			return _pBuckets[(level << _Bits) + index];
+		}
+
+		static size_t _clamp_bits(size_t bits)
+		{
+			return std::min<size_t>(std::max<size_t>(bits, 1), 16);
+		}
+
+		INLINE size_t _shift(size_t level) const
+		{
+			return level * _Bits;
+		}
+
+		bool _isLive(TimerHandle h) const
+		{
+			return h.slot < _Timers.size() && _Timers[h.slot].gen == h.gen && _Timers[h.slot].pList;
+		}
+
+		template<typename V>
+		TimerHandle _schedule(time_type deadline, V &&payload)
+		{
+			size_t slot;
+			if (_Free.empty())
+			{
+				slot = _Timers.size();
+				_Timers.emplace_back();
+			}
+			else
+			{
+				slot = _Free.back();
+				_Free.pop_back();
+			}
+			_Timer &t = _Timers[slot];
+			t.deadline = deadline;
+			t.payload.emplace(std::forward<V>(payload));
+			_place(slot);
+			_Size++;
+			return TimerHandle{ slot, t.gen };
+		}
+
+		void _place(size_t slot)
+		{	// Put the timer into the finest level whose current block contains its deadline.
+			_Timer &t = _Timers[slot];
+			_List *pList = &_Overflow;
+			if (t.deadline <= _Now)
+				pList = &_Due;
+			else
+			{
+				for (size_t l = 0; l != _Levels; l++)
+				{
+					size_t upper = _shift(l + 1);
+					if (upper >= 64 || (t.deadline >> upper) == (_Now >> upper))
+					{
+						pList = &_bucket(l, (t.deadline >> _shift(l)) & _Mask);
+						break;
+					}
+				}
+			}
+			t.pList = pList;
+			t.prev = pList->tail;
+			t.next = NIL;
+			(pList->tail == NIL ? pList->head : _Timers[pList->tail].next) = slot;
+			pList->tail = slot;
+			pList->size++;
+		}
+
+		void _unlink(size_t slot)
+		{
+			_Timer &t = _Timers[slot];
+			_List &list = *t.pList;
+			(t.prev == NIL ? list.head : _Timers[t.prev].next) = t.next;
+			(t.next == NIL ? list.tail : _Timers[t.next].prev) = t.prev;
+			list.size--;
+			t.pList = nullptr;
+		}
+
+		size_t _pop(_List &list)
+		{
+			size_t slot = list.head;
+			_unlink(slot);
+			return slot;
+		}
+
+		void _release(size_t slot)
+		{
+			_Timer &t = _Timers[slot];
+			t.payload.reset();
+			t.pList = nullptr;
+			t.gen++;
+			_Free.push_back(slot);
+			_Size--;
+		}
+
+		void _cascade()
+		{	// Redistribute the buckets whose span starts at the current tick, coarsest first.
+			if (_Levels * _Bits < 64 && (_Now & ((time_type(1) << _shift(_Levels)) - 1)) == 0)
+				_replace_list(_Overflow);
+			for (size_t l = _Levels - 1; l != 0; l--)
+			{
+				if (_Now & ((time_type(1) << _shift(l)) - 1))
+					continue;
+				_replace_list(_bucket(l, (_Now >> _shift(l)) & _Mask));
+			}
+		}
+
+		// The first tick after now at which a bucket fires or cascades,
+		// or the overflow has a timer to place
+		time_type _next_event()
+		{
+			for (size_t l = 0; l != _Levels; l++)
+			{	// a finer level's rotation ends before a coarser level's next bucket starts
+				time_type index = (_Now >> _shift(l)) & _Mask;
+				for (time_type j = index + 1; j <= _Mask; j++)
+					if (_bucket(l, j).size)
+						return ((_Now >> _shift(l)) - index + j) << _shift(l);
+			}
+			if (!_Overflow.size)
+				return UINT64_MAX;
+			// the overflow is placed again at the start of the block of its earliest deadline
+			time_type first = UINT64_MAX;
+			for (size_t slot = _Overflow.head; slot != NIL; slot = _Timers[slot].next)
+				first = std::min(first, _Timers[slot].deadline);
+			size_t top = _shift(_Levels);
+			return first >> top << top;
+		}
+
+		void _replace_list(_List &list)
+		{
+			for (size_t n = list.size; n; n--)
+				_place(_pop(list));
+		}
+
+		template<typename Func>
+		size_t _fire_list(_List &list, Func &func)
+		{	// timers added to the list by func wait for the next round,
+			// func may also cancel the timers still waiting in the list
+			size_t n = list.size, fired = 0;
+			for (; n-- && list.size; fired++)
+			{
+				size_t slot = _pop(list);
+				_Timer &t = _Timers[slot];
+				time_type deadline = t.deadline;
+				value_type payload = std::move(*t.payload);
+				_release(slot);
+				func(deadline, std::move(payload));
+			}
+			return fired;
+		}
+
+		void _clear_list(_List &list)
+		{
+			while (list.size)
+				_release(_pop(list));
+		}
+	};
+
+	void test_timing_wheel()
+	{
+		using time_type = TimingWheel<size_t>::time_type;
+		using pair_type = std::pair<time_type, size_t>;
+
+		const size_t n = 1000000;
+		std::vector<time_type> delay(n);
+		for (size_t i = 0; i != n; i++)
+			delay[i] = 1 + randint(1 << 16);
+
+		// timeout like workload, one timer is scheduled per tick and every other one is canceled
+		// a while later, the priority queue cancels lazily by skipping dead ids when they surface
+		TimingWheel<size_t> tw;
+		std::vector<TimerHandle> handles(n);
+		unsigned long long sum1 = 0, sum2 = 0;
+		auto fire1 = [&sum1](time_type deadline, size_t id) { sum1 += deadline ^ id; };
+		auto t1 = system_clock::now();
+		for (size_t i = 0; i != n; i++)
+		{
+			handles[i] = tw.schedule_after(delay[i], i);
+			if (i >= 64 && (i & 1))
+				tw.cancel(handles[i - 63]);
+			tw.advance_by(1, fire1);
+		}
+		while (!tw.empty())
+			tw.advance_by(1 << 16, fire1);
+		auto t2 = system_clock::now();
+
+		MinPriorityQueue<pair_type> pq;
+		std::vector<bool> canceled(n);
+		time_type now = 0;
+		auto fire2 = [&](time_type to)
+		{
+			while (!pq.empty() && pq.get().first <= to)
+			{
+				pair_type p = pq.pop();
+				if (!canceled[p.second])
+					sum2 += p.first ^ p.second;
+			}
+		};
+		for (size_t i = 0; i != n; i++)
+		{
+			pq.insert(pair_type(now + delay[i], i));
+			if (i >= 64 && (i & 1))
+				canceled[i - 63] = true;
+			fire2(++now);
+		}
+		fire2(UINT64_MAX);
+		auto t3 = system_clock::now();
+
+		auto d = duration<double>(t2 - t1);
+		cout << "TimingWheel cost: " << d.count() << "\tsum: " << sum1 << endl;
+		d = duration<double>(t3 - t2);
+		cout << "MinPriorityQueue cost: " << d.count() << "\tsum: " << sum2 << endl;
+	}
+}
@@ -1,4 +1,13 @@
 #pragma once
+#include <algorithm>
+#include <iterator>
+#include <limits>
+#include <future>
+#include <thread>
+#include <vector>
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE__)
+#include <xmmintrin.h>
+#endif
 #include "utils.h"
 
 
@@ -9,7 +18,7 @@ namespace lyf
 	template<typename Valt, typename Node>
 	class _BaseBinarySearchTree;
 
-	template<typename Valt>
+	template<typename Valt, typename BaseNode = UniqueNode<Valt>>
 	class BinarySearchTree;
 
 	template<typename Valt, typename Base, typename nodeptr>
@@ -99,7 +108,7 @@ namespace lyf
 	{
 		friend class _CheckedNodeContainer<BSTNode>;
 		friend class _BaseBinarySearchTree<Valt, BSTNode>;
-		friend class BinarySearchTree<Valt>;
+		friend class BinarySearchTree<Valt, Base>;
 
 	public:
 		using nodeptr = typename _CheckedNodeContainer<BSTNode<Valt, Base>>::nodeptr;
@@ -144,8 +153,130 @@ namespace lyf
 	};
 
 
+	template<typename Valt>
+	class FrozenTree
+	{	// read-only sorted values in Eytzinger (BFS) order, the children of slot k are 2k and 2k + 1.
+		// the top levels share a few cache lines, a search prefetches the slots several levels
+		// ahead and picks the child with an arithmetic step instead of a branch.
+		// the tree is complete, so a slot's position in sorted order is a closed-form
+		// function of its index, which gives O(1) select and rank from lower_bound
+	public:
+		using value_type = Valt;
+
+		FrozenTree()
+			: _Data(), _Height(0), _Last(0)
+		{
+		}
+
+		// Build from a sorted range
+		template<typename Iter>
+		FrozenTree(Iter begin, Iter end)
+			: FrozenTree()
+		{
+			std::vector<value_type> sorted(begin, end);
+			if (!std::is_sorted(sorted.begin(), sorted.end()))
+				throw std::runtime_error("The range is not sorted");
+			size_t n = sorted.size();
+			while ((size_t(1) << _Height) <= n)
+				_Height++;
+			_Last = n ? n - ((size_t(1) << (_Height - 1)) - 1) : 0;
+			_Data.reserve(n);
+			for (size_t k = 1; k <= n; k++)
+				_Data.push_back(std::move(sorted[_position(k) - 1]));
+		}
+
+		size_t size() const
+		{
+			return _Data.size();
+		}
+
+		bool empty() const
+		{
+			return _Data.empty();
+		}
+
+		// The stored value equal to the argument, nullptr if there is none
+		const value_type *search(const value_type &value) const
+		{
+			const value_type *p = lower_bound(value);
+			return p && !(value < *p) ? p : nullptr;
+		}
+
+		// The first value not less than the argument, nullptr if there is none
+		const value_type *lower_bound(const value_type &value) const
+		{
+			size_t k = _lower_bound_slot(value);
+			return k ? &_Data[k - 1] : nullptr;
+		}
+
+		// The number of values less than the argument plus one,
+		// the position lower_bound would have in sorted order
+		size_t rank(const value_type &value) const
+		{
+			size_t k = _lower_bound_slot(value);
+			return k ? _position(k) : size() + 1;
+		}
+
+		// The ith smallest value
+		const value_type &select(size_t i) const
+		{
+			if (i == 0 || i > size())
+				throw std::runtime_error("The argument i is out of range, must be in [1, size()]");
+			size_t r = i <= 2 * _Last ? i : 2 * (i - _Last);
+			size_t tz = 0;
+			while (!((r >> tz) & 1))
+				tz++;
+			size_t depth = _Height - 1 - tz;
+			return _Data[(size_t(1) << depth) + (r >> (tz + 1)) - 1];
+		}
+
+		// The in-order traversal, calling the provided function with each value
+		template<typename Func>
+		void in_order_traversal(Func func) const
+		{
+			for (size_t i = 1; i <= size(); i++)
+				func(select(i));
+		}
+
+	private:
+		std::vector<value_type> _Data;	// slot k is stored at _Data[k - 1]
+		size_t _Height;	// number of levels
+		size_t _Last;	// number of slots on the last level
+
+		size_t _lower_bound_slot(const value_type &value) const
+		{	// the slot of the first value not less than the argument, 0 if there is none
+			const size_t n = _Data.size();
+			const value_type *data = _Data.data();
+			const size_t ahead = std::max<size_t>(64 / sizeof(value_type), 1);
+			size_t k = 1;
+			while (k <= n)
+			{
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE__)
+				size_t pk = k * ahead;
+				_mm_prefetch(reinterpret_cast<const char*>(data + (pk <= n ? pk : k) - 1), _MM_HINT_T0);
+#endif
+				k = 2 * k + (data[k - 1] < value);
+			}
+			// the answer is where the search last went left, undo the right turns after it
+			while (k & 1)
+				k >>= 1;
+			return k >> 1;
+		}
+
+		size_t _position(size_t k) const
+		{	// the 1-based sorted position of slot k, counted in the perfect tree of the same height
+			// and corrected for the slots missing on the last level before it
+			size_t depth = 0;
+			while ((k >> depth) > 1)
+				depth++;
+			size_t r = (2 * (k - (size_t(1) << depth)) + 1) << (_Height - 1 - depth);
+			return r / 2 > _Last ? r - (r / 2 - _Last) : r;
+		}
+	};
+
+
 	template<typename Valt, typename Nodet>
-	class _BaseBinarySearchTree
+	class _BaseBinarySearchTree : public _CheckedNodeContainer<Nodet>
 	{
 	public:
 		using value_type = Valt;
@@ -153,14 +284,101 @@ namespace lyf
 		using check_t = _CheckedNodeContainer<Node>;
 		using nodeptr = typename check_t::nodeptr;
 
+		class const_iterator
+		{	// in-order bidirectional iterator, values are read-only since they are the keys
+			friend class _BaseBinarySearchTree;
+
+		public:
+			using iterator_category = std::bidirectional_iterator_tag;
+			using value_type = Valt;
+			using difference_type = std::ptrdiff_t;
+			using pointer = const Valt*;
+			using reference = const Valt&;
+
+			const_iterator()
+				: _np(nullptr), _pTree(nullptr)
+			{
+			}
+
+			reference operator*() const
+			{
+				return _np->value();
+			}
+
+			pointer operator->() const
+			{
+				return &_np->value();
+			}
+
+			// the node the iterator points to, null for end()
+			nodeptr node() const
+			{
+				return _np;
+			}
+
+			const_iterator &operator++()
+			{
+				_np = _pTree->_next_node(_np);
+				return *this;
+			}
+
+			const_iterator operator++(int)
+			{
+				const_iterator ret = *this;
+				++*this;
+				return ret;
+			}
+
+			const_iterator &operator--()
+			{
+				_np = _np ? _pTree->_prev_node(_np) : _pTree->max_node();
+				return *this;
+			}
+
+			const_iterator operator--(int)
+			{
+				const_iterator ret = *this;
+				--*this;
+				return ret;
+			}
+
+			bool operator==(const const_iterator &rhs) const
+			{
+				return _np == rhs._np;
+			}
+
+			bool operator!=(const const_iterator &rhs) const
+			{
+				return _np != rhs._np;
+			}
+
+		private:
+			nodeptr _np;
+			const _BaseBinarySearchTree *_pTree;
+
+			const_iterator(nodeptr np, const _BaseBinarySearchTree *pTree)
+				: _np(np), _pTree(pTree)
+			{
+			}
+		};
+
+		using iterator = const_iterator;
+		using reverse_iterator = std::reverse_iterator<const_iterator>;
+		using const_reverse_iterator = reverse_iterator;
+
 	protected:
 		_BaseBinarySearchTree()
 			: _root(Node::_Sentinel), _size()
 		{
 		}
 
+		explicit _BaseBinarySearchTree(std::pmr::memory_resource *pResource)
+			: check_t(pResource), _root(Node::_Sentinel), _size()
+		{
+		}
+
 		_BaseBinarySearchTree(_BaseBinarySearchTree &&rhs)
-			: _root(std::move(rhs._root)), _size(rhs._size)
+			: check_t(rhs), _root(std::move(rhs._root)), _size(rhs._size)
 		{
 			rhs._root = Node::_Sentinel;
 			rhs._size = 0;
@@ -171,6 +389,7 @@ namespace lyf
 			if (this != &rhs)
 			{
 				this->_destroy_subtree();
+				this->_set_resource(rhs._pResource);
 				_root = std::move(rhs._root);
 				_size = rhs._size;
 				rhs._root = Node::_Sentinel;
@@ -297,7 +516,108 @@ namespace lyf
 			this->_in_order_traversal_recursive(func, np);
 		}
 
+		// A read-only copy of the values in a cache-friendly search layout
+		FrozenTree<value_type> freeze() const
+		{
+			return FrozenTree<value_type>(this->begin(), this->end());
+		}
+
+		// Write the count and then the values in order as a contiguous array through Serializer,
+		// in blocks of sequential writes, RedBlackTree::load reads it back in O(n)
+		void save(const path &file) const
+		{
+			using serializer = Serializer<value_type>;
+			std::ofstream outf(file, std::ofstream::binary | std::ofstream::trunc);
+			if (!outf.is_open())
+				throw std::runtime_error("Fail to open file");
+			Serializer<size_t>::serialize(outf, this->size());
+			std::vector<char> block(std::max<size_t>(FILE_BLOCK / serializer::SIZE, 1) * serializer::SIZE);
+			size_t used = 0;
+			for (const value_type &v : *this)
+			{
+				serializer::serialize(block.data() + used, v);
+				used += serializer::SIZE;
+				if (used == block.size())
+				{
+					outf.write(block.data(), used);
+					used = 0;
+				}
+			}
+			outf.write(block.data(), used);
+			if (!outf)
+				throw std::runtime_error("Fail to write file");
+		}
+
+		const_iterator begin() const
+		{
+			return const_iterator(this->min_node(), this);
+		}
+
+		const_iterator end() const
+		{
+			return const_iterator(nullptr, this);
+		}
+
+		const_reverse_iterator rbegin() const
+		{
+			return const_reverse_iterator(end());
+		}
+
+		const_reverse_iterator rend() const
+		{
+			return const_reverse_iterator(begin());
+		}
+
+		// The first value not less than the argument
+		const_iterator lower_bound(const value_type &value) const
+		{
+			nodeptr np = _root, ret = Node::_Sentinel;
+			while (np != Node::_Sentinel)
+			{
+				if (np->value() < value)
+					np = np->_right;
+				else
+				{
+					ret = np;
+					np = np->_left;
+				}
+			}
+			return const_iterator(this->_conv_null_np(ret), this);
+		}
+
+		// The first value greater than the argument
+		const_iterator upper_bound(const value_type &value) const
+		{
+			nodeptr np = _root, ret = Node::_Sentinel;
+			while (np != Node::_Sentinel)
+			{
+				if (value < np->value())
+				{
+					ret = np;
+					np = np->_left;
+				}
+				else
+					np = np->_right;
+			}
+			return const_iterator(this->_conv_null_np(ret), this);
+		}
+
+		std::pair<const_iterator, const_iterator> equal_range(const value_type &value) const
+		{
+			return std::make_pair(lower_bound(value), upper_bound(value));
+		}
+
+		// Call func with every value in [lo, hi] in order,
+		// skipping the subtrees entirely outside the range, O(log n + k)
+		template<typename Func>
+		void for_each_in_range(const value_type &lo, const value_type &hi, Func func) const
+		{
+			this->_for_each_in_range_recursive(lo, hi, func, _root);
+		}
+
 	protected:
+		static constexpr size_t FILE_BLOCK = 1 << 16;	// bytes per read or write of save and load
+
 		nodeptr _root = Node::_Sentinel;
 		size_t _size = 0;
 
@@ -323,7 +643,7 @@ namespace lyf
 			{
 				_destroy_subtree_recursive(np->_left);
 				right = np->_right;
-				check_t::_delete_node(np);
+				this->_delete_node(np);
 				_size--;
 				np = right;
 			}
@@ -343,6 +663,10 @@ namespace lyf
 			else
 				_root = Node::_Sentinel;
 			_destroy_subtree_recursive(np);
+			// fixups may leave the shared sentinel pointing at a removed node,
+			// drop it so the node doesn't outlive the tree and its memory resource
+			if (Node::_Sentinel)
+				Node::_Sentinel->_parent = nullptr;
 		}
 
 		static void _copy_subtree_recursive(_BaseBinarySearchTree &dst, nodeptr dst_np, nodeptr src_np, size_t &size)
@@ -351,14 +675,14 @@ namespace lyf
 			{
 				if (src_np->_left != Node::_Sentinel)
 				{
-					dst_np->_left = check_t::_new_node(new Node(*(src_np->_left)));
+					dst_np->_left = dst._make_node(*(src_np->_left));
 					dst_np->_left->_parent = dst_np;
 					dst_np->_left->_setCont(&dst);
 					size++;
 				}
 				if (src_np->_right != Node::_Sentinel)
 				{
-					dst_np->_right = check_t::_new_node(new Node(*(src_np->_right)));
+					dst_np->_right = dst._make_node(*(src_np->_right));
 					dst_np->_right->_parent = dst_np;
 					dst_np->_right->_setCont(&dst);
 					size++;
@@ -378,7 +702,7 @@ namespace lyf
 			nodeptr curr;
 			if (np != Node::_Sentinel)
 			{
-				curr = check_t::_new_node(new Node(*np));
+				curr = dst._make_node(*np);
 				dst._root = curr;
 				curr->_setCont(&dst);
 				dst._size++;
@@ -397,15 +721,66 @@ namespace lyf
 			}
 		}
 
+		template<typename Func>
+		void _for_each_in_range_recursive(const value_type &lo, const value_type &hi, Func &func, nodeptr np) const
+		{
+			while (np != Node::_Sentinel)
+			{
+				if (np->value() < lo)
+				{
+					np = np->_right;
+					continue;
+				}
+				if (hi < np->value())
+				{
+					np = np->_left;
+					continue;
+				}
+				_for_each_in_range_recursive(lo, hi, func, np->_left);
+				func(np->value());
+				np = np->_right;
+			}
+		}
+
+		nodeptr _next_node(nodeptr np) const
+		{	// successor without the membership check, null after the last node
+			if (np->_right != Node::_Sentinel)
+			{
+				np = np->_right;
+				while (np->_left != Node::_Sentinel)
+					np = np->_left;
+				return np;
+			}
+			nodeptr p;
+			while ((p = np->_parent) != Node::_Sentinel && p->_left != np)
+				np = p;
+			return this->_conv_null_np(p);
+		}
+
+		nodeptr _prev_node(nodeptr np) const
+		{
+			if (np->_left != Node::_Sentinel)
+			{
+				np = np->_left;
+				while (np->_right != Node::_Sentinel)
+					np = np->_right;
+				return np;
+			}
+			nodeptr p;
+			while ((p = np->_parent) != Node::_Sentinel && p->_right != np)
+				np = p;
+			return this->_conv_null_np(p);
+		}
+
 	};
 
 
-	template<typename Valt>
-	class BinarySearchTree : public _BaseBinarySearchTree<Valt, BSTNode<Valt, UniqueNode<Valt>>>
+	template<typename Valt, typename BaseNode>
+	class BinarySearchTree : public _BaseBinarySearchTree<Valt, BSTNode<Valt, BaseNode>>
 	{
 	public:
 		using value_type = Valt;
-		using Node = BSTNode<Valt, UniqueNode<Valt>>;
+		using Node = BSTNode<Valt, BaseNode>;
 		using _MyBase = _BaseBinarySearchTree<Valt, Node>;
 		using check_t = typename _MyBase::check_t;
 		using nodeptr = typename check_t::nodeptr;
@@ -418,13 +793,19 @@ namespace lyf
 		{
 		}
 
+		explicit BinarySearchTree(std::pmr::memory_resource *pResource)
+			: _MyBase(pResource)
+		{
+		}
+
 		BinarySearchTree(std::initializer_list<value_type> list)
 			: BinarySearchTree(list.begin(), list.end())
 		{
 		}
 
 		template<typename Iter>
-		BinarySearchTree(Iter begin, Iter end)
+		BinarySearchTree(Iter begin, Iter end, std::pmr::memory_resource *pResource = std::pmr::get_default_resource())
+			: _MyBase(pResource)
 		{
 			for (auto it = begin; it != end; it++)
 			{
@@ -450,25 +831,25 @@ namespace lyf
 		// A copy of the subtree rooted at the given node
 		BinarySearchTree subtree(nodeptr np)
 		{
-			BinarySearchTree ret;
+			BinarySearchTree ret(this->_pResource);
 			this->_copy_subtree(ret, *this, np);
 			return ret;
 		}
 
 		nodeptr insert(const value_type &value)
 		{
-			return this->_insert_node(new Node(this, value));
+			return this->_insert_node(this->_make_node(this, value));
 		}
 
 		nodeptr insert(value_type &&value)
 		{
-			return this->_insert_node(new Node(this, std::move(value)));
+			return this->_insert_node(this->_make_node(this, std::move(value)));
 		}
 
 		template<typename... Types>
 		nodeptr emplace(Types&&... args)
 		{
-			return this->_insert_node(new Node(this, std::forward<Types>(args)...));
+			return this->_insert_node(this->_make_node(this, std::forward<Types>(args)...));
 		}
 
 		bool erase(nodeptr np)
@@ -507,7 +888,7 @@ namespace lyf
 			if (new_np != Node::_Sentinel)
 				new_np->_parent = np->_parent;
 
-			check_t::_delete_node(np);
+			this->_delete_node(np);
 			_size--;
 			return true;
 		}
@@ -521,9 +902,8 @@ namespace lyf
 
 	private:
 
-		nodeptr _insert_node(Node *pNode)
+		nodeptr _insert_node(nodeptr np)
 		{
-			nodeptr np = check_t::_new_node(pNode);
 			const value_type &npv = np->value();
 			nodeptr x = _root, y = Node::_Sentinel;
 			while (x != Node::_Sentinel)
@@ -559,6 +939,9 @@ namespace lyf
 
 	};
 
+	template<typename Valt>
+	using InlineBinarySearchTree = BinarySearchTree<Valt, InlineNode<Valt>>;
+
 
 	template<typename Valt, typename Node>
 	class RedBlackTree;
@@ -625,7 +1008,7 @@ namespace lyf
 	};
 
 	template<typename Valt, typename Base>
-	typename RBTNode<Valt, Base>::nodeptr const RBTNode<Valt, Base>::_Sentinel = check_t::_new_node(new RBTNode(RBTNodeColor::BLACK));
+	typename RBTNode<Valt, Base>::nodeptr const RBTNode<Valt, Base>::_Sentinel = check_t::_new_static_node(RBTNodeColor::BLACK);
 
 	template<typename Valt, typename Nodet = RBTNode<Valt, UniqueNode<Valt>>>
 	class RedBlackTree : public _BaseBinarySearchTree<Valt, Nodet>
@@ -643,13 +1026,19 @@ namespace lyf
 		{
 		}
 
+		explicit RedBlackTree(std::pmr::memory_resource *pResource)
+			: _MyBase(pResource)
+		{
+		}
+
 		RedBlackTree(std::initializer_list<value_type> list)
 			: RedBlackTree(list.begin(), list.end())
 		{
 		}
 
 		template<typename Iter>
-		RedBlackTree(Iter begin, Iter end)
+		RedBlackTree(Iter begin, Iter end, std::pmr::memory_resource *pResource = std::pmr::get_default_resource())
+			: _MyBase(pResource)
 		{
 			for (auto it = begin; it != end; it++)
 			{
@@ -675,25 +1064,179 @@ namespace lyf
 		// A copy of the subtree rooted at the given node
 		RedBlackTree subtree(nodeptr np)
 		{
-			RedBlackTree ret;
+			RedBlackTree ret(this->_pResource);
 			this->_copy_subtree(ret, *this, np);
 			return ret;
 		}
 
+		// Build a perfectly balanced tree from a sorted range in O(n)
+		template<typename Iter>
+		static RedBlackTree from_sorted(Iter begin, Iter end,
+			std::pmr::memory_resource *pResource = std::pmr::get_default_resource())
+		{
+			RedBlackTree ret(pResource);
+			ret._assign_sorted(begin, end);
+			return ret;
+		}
+
+		// Replace the values by those written by save, in O(n).
+		// the file is read sequentially in blocks and the tree is built bottom-up,
+		// a truncated or unsorted file leaves the tree unchanged
+		void load(const path &file)
+		{
+			using serializer = Serializer<value_type>;
+			std::ifstream inf(file, std::ifstream::binary);
+			if (!inf.is_open())
+				throw std::runtime_error("Fail to open file");
+			size_t n = 0, bytes = std::filesystem::file_size(file);
+			Serializer<size_t>::unserialize(inf, n);
+			bytes -= std::min(bytes, Serializer<size_t>::SIZE);
+			if (!inf || bytes % serializer::SIZE || bytes / serializer::SIZE != n)
+				throw std::runtime_error("The file is corrupted");
+			std::vector<value_type> values(n);
+			size_t block = std::max<size_t>(this->FILE_BLOCK / serializer::SIZE, 1);
+			std::vector<char> raw(std::min(block, n) * serializer::SIZE);
+			for (size_t i = 0; i != n; )
+			{
+				size_t cnt = std::min(block, n - i);
+				inf.read(raw.data(), cnt * serializer::SIZE);
+				if (!inf)
+					throw std::runtime_error("Fail to read file");
+				for (size_t j = 0; j != cnt; j++, i++)
+					serializer::unserialize(raw.data() + j * serializer::SIZE, values[i]);
+			}
+			this->_assign_sorted(std::make_move_iterator(values.begin()), std::make_move_iterator(values.end()));
+		}
+
+		// Append pivot and then every value of right to the tree in O(log n),
+		// no value of the tree may be greater than pivot and no value of right less than it
+		void join(const value_type &pivot, RedBlackTree &&right)
+		{
+			this->_ensure_same_resource(right);
+			if ((!this->empty() && pivot < this->max_value()) || (!right.empty() && right.min_value() < pivot))
+				throw std::runtime_error("The values are out of order");
+			nodeptr m = this->_make_node(this, pivot);
+			size_t h;
+			_root = this->_join_nodes(_root, _black_height(_root), m, right._root, _black_height(right._root), h);
+			_size += right._size + 1;
+			right._root = Node::_Sentinel;
+			right._size = 0;
+			this->_adopt_nodes(_root);
+		}
+
+		// Append every value of right to the tree in O(log n),
+		// no value of right may be less than a value of the tree
+		void join(RedBlackTree &&right)
+		{
+			this->_ensure_same_resource(right);
+			if (!this->empty() && !right.empty() && right.min_value() < this->max_value())
+				throw std::runtime_error("The values are out of order");
+			size_t h;
+			_root = this->_join2_nodes(_root, _black_height(_root), right._root, _black_height(right._root), h);
+			_size += right._size;
+			right._root = Node::_Sentinel;
+			right._size = 0;
+			this->_adopt_nodes(_root);
+		}
+
+		// Move every value not less than key into right, whose old values are removed,
+		// the split itself is O(log n), counting the moved values is O(1) for
+		// OrderStatisticTree and linear in their number otherwise
+		void split(const value_type &key, RedBlackTree &right)
+		{
+			if (this == &right)
+				throw std::runtime_error("Can't split a tree into itself");
+			this->_ensure_same_resource(right);
+			right.clear();
+			size_t hl, hr;
+			this->_split_nodes(_root, _black_height(_root), key, false, _root, hl, right._root, hr);
+			_blacken_root(_root);
+			_blacken_root(right._root);
+			right._size = this->_subtree_size(right._root);
+			_size -= right._size;
+			right._adopt_nodes(right._root);
+		}
+
+		// The set operations below treat values equal under operator== as the same element,
+		// values which are only equivalent under operator< stay distinct; they consume rhs and run the two halves of each recursion level in parallel
+		// near the top, O(m log(n/m + 1)) work for sizes m <= n
+
+		// Add the values of rhs which are not in the tree
+		void unite(RedBlackTree &&rhs)
+		{
+			this->_set_operation(std::move(rhs), [this](nodeptr a, size_t ha, nodeptr b, size_t hb,
+				size_t &h, std::vector<nodeptr> &garbage, int depth) {
+				return this->_union_nodes(a, ha, b, hb, h, garbage, depth);
+			});
+		}
+
+		// Keep only the values which are also in rhs
+		void intersect(RedBlackTree &&rhs)
+		{
+			this->_set_operation(std::move(rhs), [this](nodeptr a, size_t ha, nodeptr b, size_t hb,
+				size_t &h, std::vector<nodeptr> &garbage, int depth) {
+				return this->_intersection_nodes(a, ha, b, hb, h, garbage, depth);
+			});
+		}
+
+		// Remove the values which are in rhs
+		void subtract(RedBlackTree &&rhs)
+		{
+			this->_set_operation(std::move(rhs), [this](nodeptr a, size_t ha, nodeptr b, size_t hb,
+				size_t &h, std::vector<nodeptr> &garbage, int depth) {
+				return this->_difference_nodes(a, ha, b, hb, h, garbage, depth);
+			});
+		}
+
+		// Insert every value of the range, the batch is sorted and pushed down the tree,
+		// disjoint subtrees are updated in parallel for large batches
+		template<typename Iter>
+		void insert_batch(Iter begin, Iter end)
+		{
+			std::vector<nodeptr> nodes;
+			for (; begin != end; ++begin)
+				nodes.push_back(this->_make_node(this, *begin));
+			std::stable_sort(nodes.begin(), nodes.end(), [](const nodeptr &a, const nodeptr &b) {
+				return a->value() < b->value();
+			});
+			size_t h;
+			_root = this->_insert_batch_nodes(_root, _black_height(_root), nodes.data(),
+				nodes.data() + nodes.size(), h, _parallel_depth(_size + nodes.size()));
+			_blacken_root(_root);
+			_size += nodes.size();
+		}
+
+		// Remove every value equal to one in the range, returns the number of removed values
+		template<typename Iter>
+		size_t erase_batch(Iter begin, Iter end)
+		{
+			std::vector<value_type> values(begin, end);
+			std::sort(values.begin(), values.end());
+			std::vector<nodeptr> garbage;
+			size_t h;
+			_root = this->_erase_batch_nodes(_root, _black_height(_root), values.data(),
+				values.data() + values.size(), h, garbage, _parallel_depth(_size));
+			_blacken_root(_root);
+			for (auto &np : garbage)
+				this->_delete_node(np);
+			_size -= garbage.size();
+			return garbage.size();
+		}
+
 		nodeptr insert(const value_type &value)
 		{
-			return this->_insert_node(new Node(this, value));
+			return this->_insert_node(this->_make_node(this, value));
 		}
 
 		nodeptr insert(value_type &&value)
 		{
-			return this->_insert_node(new Node(this, std::move(value)));
+			return this->_insert_node(this->_make_node(this, std::move(value)));
 		}
 
 		template<typename... Types>
 		nodeptr emplace(Types&&... args)
 		{
-			return this->_insert_node(new Node(this, std::forward<Types>(args)...));
+			return this->_insert_node(this->_make_node(this, std::forward<Types>(args)...));
 		}
 
 		bool erase(nodeptr np)
@@ -733,8 +1276,10 @@ namespace lyf
 				np->_parent->_left = new_np;
 			else
 				np->_parent->_right = new_np;
+			for (nodeptr y = x->_parent; y != Node::_Sentinel; y = y->_parent)
+				this->_update_augment(y);
 
-			check_t::_delete_node(np);
+			this->_delete_node(np);
 			_size--;
 			if (color == RBTNodeColor::BLACK)
 				this->_remove_fixup(x);
@@ -824,47 +1369,685 @@ namespace lyf
 			np->_parent = left;
 		}
 
-		nodeptr _insert_node(Node *pNode)
+		// recompute the augmented fields of a node from its children
+		virtual void _update_augment(nodeptr np)
 		{
-			nodeptr np = check_t::_new_node(pNode);
-			const value_type &npv = np->value();
-			nodeptr curr = _root, p = Node::_Sentinel;
-			while (curr != Node::_Sentinel)
-			{
-				p = curr;
-				if (curr->value() < npv)
-					curr = curr->_right;
-				else
-					curr = curr->_left;
-			}
-			if (p == Node::_Sentinel)
-				_root = np;
-			else
-			{
-				if (p->value() < npv)
-					p->_right = np;
-				else
-					p->_left = np;
-				np->_parent = p;
-			}
-			_size++;
-			_insert_node_fixup(np);
+		}
+
+		template<typename Iter>
+		void _assign_sorted(Iter begin, Iter end)
+		{
+			if (!std::is_sorted(begin, end))
+				throw std::runtime_error("The range is not sorted");
+			this->_destroy_subtree();
+			size_t n = std::distance(begin, end);
+			auto make = [&]() {
+				nodeptr np = this->_make_node(this, *begin);
+				++begin;
+				return np;
+			};
+			_root = _build_balanced(make, n, 0, _balanced_height(n));
+			_size = n;
+		}
+
+		// depth of the deepest level of a balanced tree with n nodes
+		static size_t _balanced_height(size_t n)
+		{
+			size_t height = 0;
+			while ((size_t(2) << height) <= n)
+				height++;
+			return height;
+		}
+
+		template<typename Make>
+		nodeptr _build_balanced(Make &make, size_t n, size_t depth, size_t height)
+		{	// the left half, the node given by make, then the right half.
+			// only the nodes on the deepest level of a non-trivial tree are red,
+			// so every path has the same number of black nodes
+			if (!n)
+				return Node::_Sentinel;
+			size_t nl = (n - 1) / 2;
+			nodeptr left = _build_balanced(make, nl, depth + 1, height);
+			nodeptr np = make();
+			nodeptr right = _build_balanced(make, n - 1 - nl, depth + 1, height);
+			np->_left = left;
+			np->_right = right;
+			if (left != Node::_Sentinel)
+				left->_parent = np;
+			if (right != Node::_Sentinel)
+				right->_parent = np;
+			np->_color = depth == height && height ? RBTNodeColor::RED : RBTNodeColor::BLACK;
+			this->_update_augment(np);
 			return np;
 		}
 
-		void _insert_node_fixup(nodeptr np)
+		// number of values in the subtree
+		virtual size_t _subtree_size(nodeptr np) const
 		{
-			nodeptr y;
-			while (np->_parent->_color == RBTNodeColor::RED)
+			size_t n = 0;
+			std::vector<nodeptr> stack;
+			if (np != Node::_Sentinel)
+				stack.push_back(np);
+			while (!stack.empty())
 			{
-				if (np->_parent == np->_parent->_parent->_left)
-				{
-					y = np->_parent->_parent->_right;
-					if (y->_color == RBTNodeColor::RED)
-					{
-						np->_parent->_color = RBTNodeColor::BLACK;
-						y->_color = RBTNodeColor::BLACK;
-						np->_parent->_parent->_color = RBTNodeColor::RED;
+				np = stack.back();
+				stack.pop_back();
+				n++;
+				if (np->_left != Node::_Sentinel)
+					stack.push_back(np->_left);
+				if (np->_right != Node::_Sentinel)
+					stack.push_back(np->_right);
+			}
+			return n;
+		}
+
+		// The join-based algorithms below work on detached subtrees given by root and
+		// black height, the number of black nodes from the root down to a leaf.
+		// they never write to the shared sentinel, so disjoint subtrees can be processed in parallel
+
+		static size_t _black_height(nodeptr np)
+		{
+			size_t h = 0;
+			for (; np != Node::_Sentinel; np = np->_left)
+				if (np->_color == RBTNodeColor::BLACK)
+					h++;
+			return h;
+		}
+
+		static INLINE size_t _child_height(nodeptr np, size_t h)
+		{
+			return np->_color == RBTNodeColor::BLACK ? h - 1 : h;
+		}
+
+		static INLINE void _set_parent(nodeptr np, nodeptr p)
+		{
+			if (np != Node::_Sentinel)
+				np->_parent = p;
+		}
+
+		static void _expose(nodeptr np, nodeptr &l, nodeptr &r)
+		{	// detach the children of np
+			l = np->_left;
+			r = np->_right;
+			_set_parent(l, Node::_Sentinel);
+			_set_parent(r, Node::_Sentinel);
+			np->_left = np->_right = np->_parent = Node::_Sentinel;
+		}
+
+		void _local_left_rotate(nodeptr np, nodeptr &root)
+		{
+			nodeptr right = np->_right;
+			np->_right = right->_left;
+			_set_parent(right->_left, np);
+			right->_parent = np->_parent;
+			if (np->_parent == Node::_Sentinel)
+				root = right;
+			else if (np == np->_parent->_left)
+				np->_parent->_left = right;
+			else
+				np->_parent->_right = right;
+			right->_left = np;
+			np->_parent = right;
+			this->_update_augment(np);
+			this->_update_augment(right);
+		}
+
+		void _local_right_rotate(nodeptr np, nodeptr &root)
+		{
+			nodeptr left = np->_left;
+			np->_left = left->_right;
+			_set_parent(left->_right, np);
+			left->_parent = np->_parent;
+			if (np->_parent == Node::_Sentinel)
+				root = left;
+			else if (np == np->_parent->_right)
+				np->_parent->_right = left;
+			else
+				np->_parent->_left = left;
+			left->_right = np;
+			np->_parent = left;
+			this->_update_augment(np);
+			this->_update_augment(left);
+		}
+
+		bool _join_fixup(nodeptr np, nodeptr &root)
+		{	// insert fixup for the red node np, then refresh the augmented fields above it,
+			// returns whether the black height grew
+			nodeptr z = np;
+			while (z->_parent != Node::_Sentinel && z->_parent->_color == RBTNodeColor::RED)
+			{
+				nodeptr p = z->_parent, g = p->_parent;
+				if (p == g->_left)
+				{
+					nodeptr y = g->_right;
+					if (y->_color == RBTNodeColor::RED)
+					{
+						p->_color = y->_color = RBTNodeColor::BLACK;
+						g->_color = RBTNodeColor::RED;
+						z = g;
+						continue;
+					}
+					if (z == p->_right)
+					{
+						z = p;
+						this->_local_left_rotate(z, root);
+						p = z->_parent;
+					}
+					p->_color = RBTNodeColor::BLACK;
+					g->_color = RBTNodeColor::RED;
+					this->_local_right_rotate(g, root);
+				}
+				else
+				{
+					nodeptr y = g->_left;
+					if (y->_color == RBTNodeColor::RED)
+					{
+						p->_color = y->_color = RBTNodeColor::BLACK;
+						g->_color = RBTNodeColor::RED;
+						z = g;
+						continue;
+					}
+					if (z == p->_left)
+					{
+						z = p;
+						this->_local_right_rotate(z, root);
+						p = z->_parent;
+					}
+					p->_color = RBTNodeColor::BLACK;
+					g->_color = RBTNodeColor::RED;
+					this->_local_left_rotate(g, root);
+				}
+			}
+			bool grew = root->_color == RBTNodeColor::RED;
+			root->_color = RBTNodeColor::BLACK;
+			for (; np != Node::_Sentinel; np = np->_parent)
+				this->_update_augment(np);
+			return grew;
+		}
+
+		// Join the detached node m between the subtrees l and r, returns the new root
+		// and its black height in h, O(|hl - hr| + 1)
+		nodeptr _join_nodes(nodeptr l, size_t hl, nodeptr m, nodeptr r, size_t hr, size_t &h)
+		{
+			if (l != Node::_Sentinel && l->_color == RBTNodeColor::RED)
+			{
+				l->_color = RBTNodeColor::BLACK;
+				hl++;
+			}
+			if (r != Node::_Sentinel && r->_color == RBTNodeColor::RED)
+			{
+				r->_color = RBTNodeColor::BLACK;
+				hr++;
+			}
+			m->_parent = Node::_Sentinel;
+			if (hl == hr)
+			{
+				m->_left = l;
+				m->_right = r;
+				_set_parent(l, m);
+				_set_parent(r, m);
+				m->_color = RBTNodeColor::BLACK;
+				this->_update_augment(m);
+				h = hl + 1;
+				return m;
+			}
+			nodeptr root;
+			if (hl > hr)
+			{	// walk down the right spine of l to a black node as high as r
+				nodeptr p = Node::_Sentinel, c = l;
+				size_t hc = hl;
+				while (c->_color == RBTNodeColor::RED || hc != hr)
+				{
+					hc = _child_height(c, hc);
+					p = c;
+					c = c->_right;
+				}
+				m->_left = c;
+				m->_right = r;
+				p->_right = m;
+				root = l;
+				h = hl;
+				m->_parent = p;
+			}
+			else
+			{
+				nodeptr p = Node::_Sentinel, c = r;
+				size_t hc = hr;
+				while (c->_color == RBTNodeColor::RED || hc != hl)
+				{
+					hc = _child_height(c, hc);
+					p = c;
+					c = c->_left;
+				}
+				m->_left = l;
+				m->_right = c;
+				p->_left = m;
+				root = r;
+				h = hr;
+				m->_parent = p;
+			}
+			_set_parent(m->_left, m);
+			_set_parent(m->_right, m);
+			m->_color = RBTNodeColor::RED;
+			this->_update_augment(m);
+			if (this->_join_fixup(m, root))
+				h++;
+			return root;
+		}
+
+		// Detach the last node of the subtree np, the rest is returned in rest
+		nodeptr _split_last(nodeptr np, size_t h, nodeptr &rest, size_t &hrest)
+		{
+			size_t hc = _child_height(np, h);
+			nodeptr l, r;
+			_expose(np, l, r);
+			if (r == Node::_Sentinel)
+			{
+				rest = l;
+				hrest = hc;
+				return np;
+			}
+			nodeptr r2;
+			size_t hr2;
+			nodeptr last = this->_split_last(r, hc, r2, hr2);
+			rest = this->_join_nodes(l, hc, np, r2, hr2, hrest);
+			return last;
+		}
+
+		nodeptr _join2_nodes(nodeptr l, size_t hl, nodeptr r, size_t hr, size_t &h)
+		{
+			if (l == Node::_Sentinel)
+			{
+				h = hr;
+				return r;
+			}
+			nodeptr rest;
+			size_t hrest;
+			nodeptr m = this->_split_last(l, hl, rest, hrest);
+			return this->_join_nodes(rest, hrest, m, r, hr, h);
+		}
+
+		// Split the subtree np into the values before key (l) and the rest (r),
+		// the values equal to key go to r, or to l if upper is set
+		void _split_nodes(nodeptr np, size_t h, const value_type &key, bool upper,
+			nodeptr &l, size_t &hl, nodeptr &r, size_t &hr)
+		{
+			if (np == Node::_Sentinel)
+			{
+				l = r = Node::_Sentinel;
+				hl = hr = 0;
+				return;
+			}
+			size_t hc = _child_height(np, h);
+			nodeptr cl, cr;
+			_expose(np, cl, cr);
+			if (upper ? key < np->value() : !(np->value() < key))
+			{
+				nodeptr rr;
+				size_t hrr;
+				this->_split_nodes(cl, hc, key, upper, l, hl, rr, hrr);
+				r = this->_join_nodes(rr, hrr, np, cr, hc, hr);
+			}
+			else
+			{
+				nodeptr ll;
+				size_t hll;
+				this->_split_nodes(cr, hc, key, upper, ll, hll, r, hr);
+				l = this->_join_nodes(cl, hc, np, ll, hll, hl);
+			}
+		}
+
+		// Split around key, moving the nodes neither less nor greater than key into eq
+		void _split3_nodes(nodeptr np, size_t h, const value_type &key,
+			nodeptr &l, size_t &hl, nodeptr &r, size_t &hr, std::vector<nodeptr> &eq)
+		{
+			nodeptr rest, mid;
+			size_t hrest, hmid;
+			this->_split_nodes(np, h, key, false, l, hl, rest, hrest);
+			this->_split_nodes(rest, hrest, key, true, mid, hmid, r, hr);
+			_collect_nodes(mid, eq);
+		}
+
+		// Move m and the nodes of l and r neither less nor greater than it into cls,
+		// l and r are the exposed children of m
+		void _split_class(nodeptr m, nodeptr &l, size_t &hl, nodeptr &r, size_t &hr,
+			std::vector<nodeptr> &cls)
+		{
+			nodeptr ll, rr, mid;
+			size_t hll, hrr, hmid;
+			this->_split_nodes(l, hl, m->value(), false, ll, hll, mid, hmid);
+			_collect_nodes(mid, cls);
+			cls.push_back(m);
+			this->_split_nodes(r, hr, m->value(), true, mid, hmid, rr, hrr);
+			_collect_nodes(mid, cls);
+			l = ll, hl = hll;
+			r = rr, hr = hrr;
+		}
+
+		// whether every node of eq is equal to key, not only equivalent under operator<
+		static bool _all_equal(const std::vector<nodeptr> &eq, const value_type &key)
+		{
+			for (auto &np : eq)
+				if (!(np->value() == key))
+					return false;
+			return true;
+		}
+
+		static bool _contains_equal(const std::vector<nodeptr> &nodes, const value_type &key)
+		{
+			for (auto &np : nodes)
+				if (np->value() == key)
+					return true;
+			return false;
+		}
+
+		// join l, the equivalent nodes of cls and r
+		nodeptr _join_class(nodeptr l, size_t hl, std::vector<nodeptr> &cls, nodeptr r, size_t hr, size_t &h)
+		{
+			size_t n = cls.size(), height = _balanced_height(n), hm, hlm;
+			auto it = cls.begin();
+			auto make = [&]() { return *it++; };
+			nodeptr m = this->_build_balanced(make, n, 0, height);
+			_set_parent(m, Node::_Sentinel);
+			hm = n ? (height ? height : 1) : 0;
+			m = this->_join2_nodes(l, hl, m, hm, hlm);
+			return this->_join2_nodes(m, hlm, r, hr, h);
+		}
+
+		static size_t _collect_nodes(nodeptr np, std::vector<nodeptr> &garbage)
+		{
+			size_t first = garbage.size();
+			if (np != Node::_Sentinel)
+				garbage.push_back(np);
+			for (size_t i = first; i != garbage.size(); i++)
+			{
+				np = garbage[i];
+				if (np->_left != Node::_Sentinel)
+					garbage.push_back(np->_left);
+				if (np->_right != Node::_Sentinel)
+					garbage.push_back(np->_right);
+			}
+			return garbage.size() - first;
+		}
+
+		template<typename Func>
+		void _fork_join(Func func, nodeptr al, size_t hal, nodeptr bl, size_t hbl, nodeptr &l, size_t &hl,
+			nodeptr ar, size_t har, nodeptr br, size_t hbr, nodeptr &r, size_t &hr,
+			std::vector<nodeptr> &garbage, int depth)
+		{	// run the left half in another thread while depth allows
+			std::vector<nodeptr> left_garbage;
+			std::vector<nodeptr> &lg = depth > 0 ? left_garbage : garbage;
+			_parallel_invoke([&]() { l = func(al, hal, bl, hbl, hl, lg, depth - 1); },
+				[&]() { r = func(ar, har, br, hbr, hr, garbage, depth - 1); }, depth > 0);
+			garbage.insert(garbage.end(), left_garbage.begin(), left_garbage.end());
+		}
+
+		template<typename Left, typename Right>
+		static void _parallel_invoke(Left left, Right right, bool parallel)
+		{
+			if (parallel)
+			{
+				auto future = std::async(std::launch::async, left);
+				right();
+				future.get();
+			}
+			else
+			{
+				left();
+				right();
+			}
+		}
+
+		// levels of recursion to fork, about log2 of the hardware threads for large inputs
+		static int _parallel_depth(size_t total)
+		{
+			int depth = 0;
+			if (total >= (1 << 14))
+				for (size_t t = std::thread::hardware_concurrency(); t > 1; t >>= 1)
+					depth++;
+			return depth;
+		}
+
+		nodeptr _union_nodes(nodeptr a, size_t ha, nodeptr b, size_t hb, size_t &h,
+			std::vector<nodeptr> &garbage, int depth)
+		{
+			if (a == Node::_Sentinel || b == Node::_Sentinel)
+			{
+				h = a == Node::_Sentinel ? hb : ha;
+				return a == Node::_Sentinel ? b : a;
+			}
+			size_t hc = _child_height(a, ha);
+			nodeptr al, ar, bl, br, l, r;
+			size_t hbl, hbr, hl, hr;
+			size_t hal = hc, har = hc;
+			std::vector<nodeptr> eq, cls, kept;
+			_expose(a, al, ar);
+			this->_split3_nodes(b, hb, a->value(), bl, hbl, br, hbr, eq);
+			bool simple = _all_equal(eq, a->value());
+			if (simple)
+				garbage.insert(garbage.end(), eq.begin(), eq.end());
+			else
+			{	// equivalent but unequal values, like intervals with the same low end,
+				// match the whole class of a against the nodes of b
+				this->_split_class(a, al, hal, ar, har, cls);
+				kept = cls;
+				for (auto &np : eq)
+					(_contains_equal(cls, np->value()) ? garbage : kept).push_back(np);
+			}
+			this->_fork_join([this](nodeptr x, size_t hx, nodeptr y, size_t hy, size_t &hz,
+				std::vector<nodeptr> &g, int d) { return this->_union_nodes(x, hx, y, hy, hz, g, d); },
+				al, hal, bl, hbl, l, hl, ar, har, br, hbr, r, hr, garbage, depth);
+			if (simple)
+				return this->_join_nodes(l, hl, a, r, hr, h);
+			return this->_join_class(l, hl, kept, r, hr, h);
+		}
+
+		nodeptr _intersection_nodes(nodeptr a, size_t ha, nodeptr b, size_t hb, size_t &h,
+			std::vector<nodeptr> &garbage, int depth)
+		{
+			if (a == Node::_Sentinel || b == Node::_Sentinel)
+			{
+				_collect_nodes(a, garbage);
+				_collect_nodes(b, garbage);
+				h = 0;
+				return Node::_Sentinel;
+			}
+			size_t hc = _child_height(a, ha);
+			nodeptr al, ar, bl, br, l, r;
+			size_t hbl, hbr, hl, hr;
+			size_t hal = hc, har = hc;
+			std::vector<nodeptr> eq, cls, kept;
+			_expose(a, al, ar);
+			this->_split3_nodes(b, hb, a->value(), bl, hbl, br, hbr, eq);
+			bool simple = _all_equal(eq, a->value()), found = !eq.empty();
+			if (!simple)
+			{	// keep the nodes of the class of a with an equal node in b
+				this->_split_class(a, al, hal, ar, har, cls);
+				for (auto &np : cls)
+					(_contains_equal(eq, np->value()) ? kept : garbage).push_back(np);
+			}
+			garbage.insert(garbage.end(), eq.begin(), eq.end());
+			this->_fork_join([this](nodeptr x, size_t hx, nodeptr y, size_t hy, size_t &hz,
+				std::vector<nodeptr> &g, int d) { return this->_intersection_nodes(x, hx, y, hy, hz, g, d); },
+				al, hal, bl, hbl, l, hl, ar, har, br, hbr, r, hr, garbage, depth);
+			if (!simple)
+				return this->_join_class(l, hl, kept, r, hr, h);
+			if (found)
+				return this->_join_nodes(l, hl, a, r, hr, h);
+			garbage.push_back(a);
+			return this->_join2_nodes(l, hl, r, hr, h);
+		}
+
+		nodeptr _difference_nodes(nodeptr a, size_t ha, nodeptr b, size_t hb, size_t &h,
+			std::vector<nodeptr> &garbage, int depth)
+		{
+			if (a == Node::_Sentinel || b == Node::_Sentinel)
+			{
+				_collect_nodes(b, garbage);
+				h = ha;
+				return a;
+			}
+			size_t hc = _child_height(b, hb);
+			nodeptr al, ar, bl, br, l, r;
+			size_t hal, har, hl, hr, hbl = hc, hbr = hc;
+			std::vector<nodeptr> eq, cls, kept;
+			_expose(b, bl, br);
+			this->_split3_nodes(a, ha, b->value(), al, hal, ar, har, eq);
+			bool simple = _all_equal(eq, b->value());
+			if (simple)
+			{
+				garbage.insert(garbage.end(), eq.begin(), eq.end());
+				garbage.push_back(b);
+			}
+			else
+			{	// remove only the nodes of a with an equal node in the class of b
+				this->_split_class(b, bl, hbl, br, hbr, cls);
+				for (auto &np : eq)
+					(_contains_equal(cls, np->value()) ? garbage : kept).push_back(np);
+				garbage.insert(garbage.end(), cls.begin(), cls.end());
+			}
+			this->_fork_join([this](nodeptr x, size_t hx, nodeptr y, size_t hy, size_t &hz,
+				std::vector<nodeptr> &g, int d) { return this->_difference_nodes(x, hx, y, hy, hz, g, d); },
+				al, hal, bl, hbl, l, hl, ar, har, br, hbr, r, hr, garbage, depth);
+			if (simple)
+				return this->_join2_nodes(l, hl, r, hr, h);
+			return this->_join_class(l, hl, kept, r, hr, h);
+		}
+
+		template<typename Func>
+		void _set_operation(RedBlackTree &&rhs, Func func)
+		{
+			if (this == &rhs)
+				throw std::runtime_error("The operands must be different trees");
+			this->_ensure_same_resource(rhs);
+			size_t total = _size + rhs._size;
+			std::vector<nodeptr> garbage;
+			size_t h;
+			nodeptr a = _root, b = rhs._root;
+			rhs._root = Node::_Sentinel;
+			rhs._size = 0;
+			_root = func(a, _black_height(a), b, _black_height(b), h, garbage, _parallel_depth(total));
+			for (auto &np : garbage)
+				this->_delete_node(np);
+			_size = total - garbage.size();
+			_blacken_root(_root);
+			this->_adopt_nodes(_root);
+		}
+
+		// Insert the detached nodes [first, last), sorted by value, into the subtree np
+		nodeptr _insert_batch_nodes(nodeptr np, size_t h, nodeptr *first, nodeptr *last,
+			size_t &hout, int depth)
+		{
+			if (first == last)
+			{
+				hout = h;
+				return np;
+			}
+			if (np == Node::_Sentinel)
+			{	// nothing to merge with, build a balanced subtree of the batch
+				size_t n = last - first, height = _balanced_height(n);
+				auto make = [&]() { return *first++; };
+				hout = height ? height : 1;
+				return this->_build_balanced(make, n, 0, height);
+			}
+			size_t hc = _child_height(np, h);
+			nodeptr l, r;
+			size_t hl, hr;
+			_expose(np, l, r);
+			nodeptr *mid = std::partition_point(first, last, [&](const nodeptr &x) {
+				return !(np->value() < x->value());
+			});
+			_parallel_invoke([&]() { l = this->_insert_batch_nodes(l, hc, first, mid, hl, depth - 1); },
+				[&]() { r = this->_insert_batch_nodes(r, hc, mid, last, hr, depth - 1); }, depth > 0);
+			return this->_join_nodes(l, hl, np, r, hr, hout);
+		}
+
+		// Remove the nodes of the subtree np equal to a value in the sorted [first, last)
+		nodeptr _erase_batch_nodes(nodeptr np, size_t h, const value_type *first, const value_type *last,
+			size_t &hout, std::vector<nodeptr> &garbage, int depth)
+		{
+			if (np == Node::_Sentinel || first == last)
+			{
+				hout = h;
+				return np;
+			}
+			size_t hc = _child_height(np, h);
+			nodeptr l, r;
+			size_t hl, hr;
+			_expose(np, l, r);
+			const value_type *lo = std::lower_bound(first, last, np->value());
+			const value_type *hi = std::upper_bound(lo, last, np->value());
+			std::vector<nodeptr> left_garbage;
+			std::vector<nodeptr> &lg = depth > 0 ? left_garbage : garbage;
+			_parallel_invoke([&]() { l = this->_erase_batch_nodes(l, hc, first, hi, hl, lg, depth - 1); },
+				[&]() { r = this->_erase_batch_nodes(r, hc, lo, last, hr, garbage, depth - 1); }, depth > 0);
+			garbage.insert(garbage.end(), left_garbage.begin(), left_garbage.end());
+			// [lo, hi) is only equivalent under operator<, e.g. intervals with the same low end
+			if (std::find(lo, hi, np->value()) == hi)
+				return this->_join_nodes(l, hl, np, r, hr, hout);
+			garbage.push_back(np);
+			return this->_join2_nodes(l, hl, r, hr, hout);
+		}
+
+		static void _blacken_root(nodeptr np)
+		{
+			if (np != Node::_Sentinel)
+				np->_color = RBTNodeColor::BLACK;
+		}
+
+		// mark the nodes under np as owned by this tree, only needed for the checked build
+		void _adopt_nodes(nodeptr np)
+		{
+#if _DEBUG
+			std::vector<nodeptr> nodes;
+			_collect_nodes(np, nodes);
+			for (auto &node : nodes)
+				node->_setCont(this);
+#endif
+		}
+
+		nodeptr _insert_node(nodeptr np)
+		{
+			const value_type &npv = np->value();
+			nodeptr curr = _root, p = Node::_Sentinel;
+			while (curr != Node::_Sentinel)
+			{
+				p = curr;
+				if (curr->value() < npv)
+					curr = curr->_right;
+				else
+					curr = curr->_left;
+			}
+			if (p == Node::_Sentinel)
+				_root = np;
+			else
+			{
+				if (p->value() < npv)
+					p->_right = np;
+				else
+					p->_left = np;
+				np->_parent = p;
+			}
+			for (; p != Node::_Sentinel; p = p->_parent)
+				this->_update_augment(p);
+			_size++;
+			_insert_node_fixup(np);
+			return np;
+		}
+
+		void _insert_node_fixup(nodeptr np)
+		{
+			nodeptr y;
+			while (np->_parent->_color == RBTNodeColor::RED)
+			{
+				if (np->_parent == np->_parent->_parent->_left)
+				{
+					y = np->_parent->_parent->_right;
+					if (y->_color == RBTNodeColor::RED)
+					{
+						np->_parent->_color = RBTNodeColor::BLACK;
+						y->_color = RBTNodeColor::BLACK;
+						np->_parent->_parent->_color = RBTNodeColor::RED;
 						np = np->_parent->_parent;
 					}
 					else
@@ -984,14 +2167,95 @@ namespace lyf
 
 	};
 
+	template<typename Valt>
+	using InlineRedBlackTree = RedBlackTree<Valt, RBTNode<Valt, InlineNode<Valt>>>;
+
+
+	// Monoids for the augmented OrderStatisticTree, a monoid provides
+	// result_type, identity(), lift(value) and an associative combine(lhs, rhs)
+	template<typename Valt>
+	struct SumMonoid
+	{
+		using result_type = Valt;
+
+		static result_type identity() { return result_type(); }
+
+		static result_type lift(const Valt &v) { return v; }
+
+		static result_type combine(const result_type &lhs, const result_type &rhs) { return lhs + rhs; }
+	};
+
+	template<typename Valt>
+	struct CountMonoid
+	{
+		using result_type = size_t;
+
+		static result_type identity() { return 0; }
+
+		static result_type lift(const Valt &) { return 1; }
+
+		static result_type combine(result_type lhs, result_type rhs) { return lhs + rhs; }
+	};
+
+	template<typename Valt>
+	struct MinMonoid
+	{
+		using result_type = Valt;
+
+		static result_type identity() { return std::numeric_limits<Valt>::max(); }
+
+		static result_type lift(const Valt &v) { return v; }
+
+		static result_type combine(const result_type &lhs, const result_type &rhs) { return rhs < lhs ? rhs : lhs; }
+	};
+
+	template<typename Valt>
+	struct MaxMonoid
+	{
+		using result_type = Valt;
+
+		static result_type identity() { return std::numeric_limits<Valt>::lowest(); }
+
+		static result_type lift(const Valt &v) { return v; }
+
+		static result_type combine(const result_type &lhs, const result_type &rhs) { return lhs < rhs ? rhs : lhs; }
+	};
+
+
+	template<typename Valt, typename Monoid>
+	struct _Aggregate
+	{	// the monoid combination of a subtree, kept in the nodes of an augmented tree
+		using result_type = typename Monoid::result_type;
+
+		result_type value = Monoid::identity();
+
+		void reset(const Valt &v)
+		{
+			value = Monoid::lift(v);
+		}
+
+		void update(const _Aggregate &lhs, const Valt &v, const _Aggregate &rhs)
+		{
+			value = Monoid::combine(Monoid::combine(lhs.value, Monoid::lift(v)), rhs.value);
+		}
+	};
+
+	template<typename Valt>
+	struct _Aggregate<Valt, void>
+	{	// no monoid, fits in the padding after the node color
+		void reset(const Valt &) {}
+
+		void update(const _Aggregate &, const Valt &, const _Aggregate &) {}
+	};
+
 
 	template<typename Valt, typename Node>
 	class OrderStatisticTree;
 
-	// Node class of order-statistic tree
-	template<typename Valt, typename Base>
+	// Node class of order-statistic tree, Monoid adds the aggregate of the subtree
+	template<typename Valt, typename Base, typename Monoid = void>
 	class OSTNode : public _BaseBSTNode<Valt, Base,
-		typename _CheckedNodeContainer<OSTNode<Valt, Base>>::nodeptr>
+		typename _CheckedNodeContainer<OSTNode<Valt, Base, Monoid>>::nodeptr>
 	{
 		friend class _CheckedNodeContainer<OSTNode>;
 		friend class _BaseBinarySearchTree<Valt, OSTNode>;
@@ -999,6 +2263,7 @@ namespace lyf
 		friend class OrderStatisticTree<Valt, OSTNode>;
 
 	public:
+		using monoid_type = Monoid;
 		using check_t = _CheckedNodeContainer<OSTNode>;
 		using nodeptr = typename check_t::nodeptr;
 		using _MyBase = _BaseBSTNode<Valt, Base, nodeptr>;
@@ -1015,9 +2280,17 @@ namespace lyf
 			return _size;
 		}
 
+		// The combined values of the subtree rooted at the node, only with a monoid
+		const auto &aggregate() const
+		{
+			this->_ensureInCont();
+			return _agg.value;
+		}
+
 	private:
 		static nodeptr const _Sentinel;
 		RBTNodeColor _color = RBTNodeColor::RED;
+		_Aggregate<Valt, Monoid> _agg;
 		size_t _size = 1;
 
 		using _MyBase::_MyBase;
@@ -1035,38 +2308,43 @@ namespace lyf
 		OSTNode(void *pCont, const Valt &value)
 			: _MyBase(_Sentinel, pCont, value)
 		{
+			_agg.reset(this->value());
 		}
 
 		OSTNode(void *pCont, Valt &&value)
 			: _MyBase(_Sentinel, pCont, std::move(value))
 		{
+			_agg.reset(this->value());
 		}
 
 		template<typename... Types>
 		OSTNode(void *pCont, Types&&... args)
 			: _MyBase(_Sentinel, pCont, std::forward<Types>(args)...)
 		{
+			_agg.reset(this->value());
 		}
 
 		OSTNode(const OSTNode &rhs)
-			: _MyBase(rhs), _color(rhs._color), _size(rhs._size)
+			: _MyBase(rhs), _color(rhs._color), _agg(rhs._agg), _size(rhs._size)
 		{
 			_parent = _left = _right = _Sentinel;
 		}
 	};
 
-	template<typename Valt, typename Base>
-	typename OSTNode<Valt, Base>::nodeptr const OSTNode<Valt, Base>::_Sentinel = check_t::_new_node(new OSTNode(RBTNodeColor::BLACK, 0));
+	template<typename Valt, typename Base, typename Monoid>
+	typename OSTNode<Valt, Base, Monoid>::nodeptr const OSTNode<Valt, Base, Monoid>::_Sentinel = check_t::_new_static_node(RBTNodeColor::BLACK, 0);
 
 	template<typename Valt, typename Nodet = OSTNode<Valt, UniqueNode<Valt>>>
 	class OrderStatisticTree : public RedBlackTree<Valt, Nodet>
-	{
+	{	// red-black tree keeping the size of every subtree, and with a monoid
+		// in the node type, the combination of the values of every subtree
 	public:
 		using value_type = Valt;
 		using Node = Nodet;
 		using _MyBase = RedBlackTree<Valt, Node>;
 		using check_t = typename _MyBase::check_t;
 		using nodeptr = typename check_t::nodeptr;
+		using Monoid = typename Node::monoid_type;
 
 	public:
 		OrderStatisticTree()
@@ -1074,13 +2352,19 @@ namespace lyf
 		{
 		}
 
+		explicit OrderStatisticTree(std::pmr::memory_resource *pResource)
+			: _MyBase(pResource)
+		{
+		}
+
 		OrderStatisticTree(std::initializer_list<value_type> list)
 			: OrderStatisticTree(list.begin(), list.end())
 		{
 		}
 
 		template<typename Iter>
-		OrderStatisticTree(Iter begin, Iter end)
+		OrderStatisticTree(Iter begin, Iter end, std::pmr::memory_resource *pResource = std::pmr::get_default_resource())
+			: _MyBase(pResource)
 		{
 			for (auto it = begin; it != end; it++)
 			{
@@ -1106,11 +2390,21 @@ namespace lyf
 		// A copy of the subtree rooted at the given node
 		OrderStatisticTree subtree(nodeptr np)
 		{
-			OrderStatisticTree ret;
+			OrderStatisticTree ret(this->_pResource);
 			this->_copy_subtree(ret, *this, np);
 			return ret;
 		}
 
+		// Build a perfectly balanced tree from a sorted range in O(n)
+		template<typename Iter>
+		static OrderStatisticTree from_sorted(Iter begin, Iter end,
+			std::pmr::memory_resource *pResource = std::pmr::get_default_resource())
+		{
+			OrderStatisticTree ret(pResource);
+			ret._assign_sorted(begin, end);
+			return ret;
+		}
+
 		// Returns a pointer to the node containing the ith smallest key
 		// in the subtree rooted at the argument np(default the tree's root)
 		nodeptr select(size_t i, nodeptr np = nullptr)
@@ -1148,91 +2442,61 @@ namespace lyf
 			return r;
 		}
 
-		nodeptr insert(const value_type &value)
-		{
-			return this->_insert_node(new Node(this, value));
-		}
-
-		nodeptr insert(value_type &&value)
+		// The combination of every value in the tree, needs a monoid
+		auto aggregate() const
 		{
-			return this->_insert_node(new Node(this, std::move(value)));
+			return _root->_agg.value;
 		}
 
-		template<typename... Types>
-		nodeptr emplace(Types&&... args)
+		// The combination of the values in [lo, hi], in order, O(log n)
+		auto aggregate(const value_type &lo, const value_type &hi) const
 		{
-			return this->_insert_node(new Node(this, std::forward<Types>(args)...));
-		}
-
-		bool erase(nodeptr np)
-		{
-			if (!np || np == Node::_Sentinel)
-				return false;
-			this->_ensureInTree(np);
-			nodeptr new_np, x;
-			RBTNodeColor color = np->_color;
-			if (np->_left == Node::_Sentinel || np->_right == Node::_Sentinel)
-			{
-				new_np = np->_left == Node::_Sentinel ? np->_right : np->_left;
-				x = new_np;
+			nodeptr np = _root;
+			while (np != Node::_Sentinel)
+			{	// the highest node inside the range splits it into two boundary paths
+				if (np->value() < lo)
+					np = np->_right;
+				else if (hi < np->value())
+					np = np->_left;
+				else
+					break;
 			}
-			else
-			{
-				new_np = this->min_node(np->_right);
-				color = new_np->_color;
-				x = new_np->_right;
-				if (new_np != np->_right)
+			if (np == Node::_Sentinel)
+				return Monoid::identity();
+			typename Monoid::result_type left = Monoid::identity(), right = Monoid::identity();
+			for (nodeptr curr = np->_left; curr != Node::_Sentinel; )
+			{	// the values not less than lo, whole right subtrees are taken at once
+				if (curr->value() < lo)
+					curr = curr->_right;
+				else
 				{
-					x->_parent = new_np->_parent;
-					new_np->_parent->_left = x;
-					new_np->_right = np->_right;
-					np->_right->_parent = new_np;
+					left = Monoid::combine(Monoid::combine(Monoid::lift(curr->value()), curr->_right->_agg.value), left);
+					curr = curr->_left;
 				}
-				else
-					x->_parent = new_np;
-				new_np->_left = np->_left;
-				np->_left->_parent = new_np;
-				new_np->_color = np->_color;
-				new_np->_size = np->_size;
 			}
-			new_np->_parent = np->_parent;
-			if (np->_parent == Node::_Sentinel)
-				_root = new_np;
-			else if (np == np->_parent->_left)
-				np->_parent->_left = new_np;
-			else
-				np->_parent->_right = new_np;
-
-			nodeptr y = x->_parent;
-			while (y != Node::_Sentinel)
+			for (nodeptr curr = np->_right; curr != Node::_Sentinel; )
 			{
-				y->_size--;
-				y = y->_parent;
+				if (hi < curr->value())
+					curr = curr->_left;
+				else
+				{
+					right = Monoid::combine(right, Monoid::combine(curr->_left->_agg.value, Monoid::lift(curr->value())));
+					curr = curr->_right;
+				}
 			}
-
-			check_t::_delete_node(np);
-			_size--;
-			if (color == RBTNodeColor::BLACK)
-				this->_remove_fixup(x);
-			return true;
-		}
-
-		// Remove the value, returns whether it's in the tree or not
-		bool remove(const value_type &value)
-		{
-			nodeptr np = this->search(value);
-			return this->erase(np);
+			return Monoid::combine(Monoid::combine(left, Monoid::lift(np->value())), right);
 		}
 
 	protected:
 		virtual void _left_rotate(nodeptr np) override
-		{
+		{	// the new top takes over the whole subtree
 			this->_ensureInTree(np);
 			if (np->_right == Node::_Sentinel)
 				return;
 			np->_right->_size = np->_size;
+			np->_right->_agg = np->_agg;
 			_MyBase::_left_rotate(np);
-			np->_size = np->_left->_size + np->_right->_size + 1;
+			this->_update_augment(np);
 		}
 
 		virtual void _right_rotate(nodeptr np) override
@@ -1241,40 +2505,26 @@ namespace lyf
 			if (np->_left == Node::_Sentinel)
 				return;
 			np->_left->_size = np->_size;
+			np->_left->_agg = np->_agg;
 			_MyBase::_right_rotate(np);
+			this->_update_augment(np);
+		}
+
+		virtual void _update_augment(nodeptr np) override
+		{
 			np->_size = np->_left->_size + np->_right->_size + 1;
+			np->_agg.update(np->_left->_agg, np->value(), np->_right->_agg);
 		}
 
-		nodeptr _insert_node(Node *pNode)
+		virtual size_t _subtree_size(nodeptr np) const override
 		{
-			nodeptr np = check_t::_new_node(pNode);
-			const value_type &npv = np->value();
-			nodeptr curr = _root, p = Node::_Sentinel;
-			while (curr != Node::_Sentinel)
-			{
-				p = curr;
-				curr->_size++;
-				if (curr->value() < npv)
-					curr = curr->_right;
-				else
-					curr = curr->_left;
-			}
-			if (p == Node::_Sentinel)
-				_root = np;
-			else
-			{
-				if (p->value() < npv)
-					p->_right = np;
-				else
-					p->_left = np;
-				np->_parent = p;
-			}
-			_size++;
-			_insert_node_fixup(np);
-			return np;
+			return np->_size;
 		}
 	};
 
+	template<typename Valt>
+	using InlineOrderStatisticTree = OrderStatisticTree<Valt, OSTNode<Valt, InlineNode<Valt>>>;
+
 
 	template<typename Valt, typename Node>
 	class IntervalTree;
@@ -1416,7 +2666,7 @@ namespace lyf
 	};
 
 	template<typename Valt, typename Base>
-	typename INTNode<Valt, Base>::nodeptr const INTNode<Valt, Base>::_Sentinel = check_t::_new_node(new INTNode(RBTNodeColor::BLACK));
+	typename INTNode<Valt, Base>::nodeptr const INTNode<Valt, Base>::_Sentinel = check_t::_new_static_node(RBTNodeColor::BLACK);
 
 	template<typename Valt, typename Nodet = INTNode<Valt, UniqueNode<Interval<Valt>>>>
 	class IntervalTree : public RedBlackTree<Interval<Valt>, Nodet>
@@ -1434,13 +2684,19 @@ namespace lyf
 		{
 		}
 
+		explicit IntervalTree(std::pmr::memory_resource *pResource)
+			: _MyBase(pResource)
+		{
+		}
+
 		IntervalTree(std::initializer_list<value_type> list)
 			: IntervalTree(list.begin(), list.end())
 		{
 		}
 
 		template<typename Iter>
-		IntervalTree(Iter begin, Iter end)
+		IntervalTree(Iter begin, Iter end, std::pmr::memory_resource *pResource = std::pmr::get_default_resource())
+			: _MyBase(pResource)
 		{
 			for (auto it = begin; it != end; it++)
 			{
@@ -1466,11 +2722,21 @@ namespace lyf
 		// A copy of the subtree rooted at the given node
 		IntervalTree subtree(nodeptr np)
 		{
-			IntervalTree ret;
+			IntervalTree ret(this->_pResource);
 			this->_copy_subtree(ret, *this, np);
 			return ret;
 		}
 
+		// Build a perfectly balanced tree from a sorted range in O(n)
+		template<typename Iter>
+		static IntervalTree from_sorted(Iter begin, Iter end,
+			std::pmr::memory_resource *pResource = std::pmr::get_default_resource())
+		{
+			IntervalTree ret(pResource);
+			ret._assign_sorted(begin, end);
+			return ret;
+		}
+
 		nodeptr search(const Valt &low, const Valt &high) const
 		{
 			return _MyBase::search(Interval<Valt>(low, high));
@@ -1494,20 +2760,55 @@ namespace lyf
 			return intersect_search(Interval<Valt>(low, high));
 		}
 
+		// Call func with every interval overlapping i, in order of low endpoints.
+		// subtrees whose max ends before i are skipped, O(min(n, k log n)) for k overlaps
+		template<typename Func>
+		void for_each_overlap(const value_type &i, Func func) const
+		{
+			this->_for_each_overlap_recursive(i, func, _root);
+		}
+
+		// Write every interval overlapping i to out, returns the number written
+		template<typename OutputIter>
+		size_t overlaps(const value_type &i, OutputIter out) const
+		{
+			size_t n = 0;
+			auto write = [&](const value_type &v) {
+				*out++ = v;
+				n++;
+			};
+			this->_for_each_overlap_recursive(i, write, _root);
+			return n;
+		}
+
+		// Write a (point, interval) pair to out for every point of the range and every
+		// interval containing it, returns the number of pairs written.
+		// the points are sorted once and the sorted points are pushed down the tree together,
+		// each subtree only sees the points its intervals can contain
+		template<typename Iter, typename OutputIter>
+		size_t stab_batch(Iter begin, Iter end, OutputIter out) const
+		{
+			std::vector<Valt> points(begin, end);
+			std::sort(points.begin(), points.end());
+			size_t n = 0;
+			this->_stab_recursive(points.data(), points.data() + points.size(), out, n, _root);
+			return n;
+		}
+
 		nodeptr insert(const value_type &value)
 		{
-			return this->_insert_node(new Node(this, value));
+			return this->_insert_node(this->_make_node(this, value));
 		}
 
 		nodeptr insert(value_type &&value)
 		{
-			return this->_insert_node(new Node(this, std::move(value)));
+			return this->_insert_node(this->_make_node(this, std::move(value)));
 		}
 
 		template<typename... Types>
 		nodeptr emplace(Types&&... args)
 		{
-			return this->_insert_node(new Node(this, std::forward<Types>(args)...));
+			return this->_insert_node(this->_make_node(this, std::forward<Types>(args)...));
 		}
 
 		bool erase(nodeptr np)
@@ -1555,7 +2856,7 @@ namespace lyf
 				y = y->_parent;
 			}
 
-			check_t::_delete_node(np);
+			this->_delete_node(np);
 			_size--;
 			if (color == RBTNodeColor::BLACK)
 				this->_remove_fixup(x);
@@ -1590,9 +2891,47 @@ namespace lyf
 			np->_update_max();
 		}
 
-		nodeptr _insert_node(Node *pNode)
+		virtual void _update_augment(nodeptr np) override
+		{
+			np->_update_max();
+		}
+
+		template<typename Func>
+		void _for_each_overlap_recursive(const value_type &i, Func &func, nodeptr np) const
+		{
+			while (np != Node::_Sentinel && !(np->_max < i.low))
+			{
+				_for_each_overlap_recursive(i, func, np->_left);
+				if (i.high < np->value().low)
+					return;	// the node and its right subtree start after i
+				if (!(np->value().high < i.low))
+					func(np->value());
+				np = np->_right;
+			}
+		}
+
+		template<typename OutputIter>
+		void _stab_recursive(const Valt *first, const Valt *last, OutputIter &out, size_t &n, nodeptr np) const
+		{
+			while (np != Node::_Sentinel && first != last)
+			{
+				last = std::upper_bound(first, last, np->_max);	// the points past every interval end
+				if (first == last)
+					return;
+				_stab_recursive(first, last, out, n, np->_left);
+				const value_type &v = np->value();
+				first = std::lower_bound(first, last, v.low);	// the right subtree starts at v.low
+				for (const Valt *p = first; p != last && !(v.high < *p); ++p)
+				{
+					*out++ = std::make_pair(*p, v);
+					n++;
+				}
+				np = np->_right;
+			}
+		}
+
+		nodeptr _insert_node(nodeptr np)
 		{
-			nodeptr np = check_t::_new_node(pNode);
 			const value_type &npv = np->value();
 			nodeptr curr = _root, p = Node::_Sentinel;
 			while (curr != Node::_Sentinel)
@@ -1619,4 +2958,16 @@ namespace lyf
 			return np;
 		}
 	};
+
+	template<typename Valt>
+	using InlineIntervalTree = IntervalTree<Valt, INTNode<Valt, InlineNode<Interval<Valt>>>>;
+
+
+	// OrderStatisticTree keeping the monoid combination of every subtree in its root,
+	// so the aggregate of any value range is found in O(log n)
+	template<typename Valt, typename Monoid = SumMonoid<Valt>, typename Nodet = OSTNode<Valt, UniqueNode<Valt>, Monoid>>
+	using AugmentedTree = OrderStatisticTree<Valt, Nodet>;
+
+	template<typename Valt, typename Monoid = SumMonoid<Valt>>
+	using InlineAugmentedTree = AugmentedTree<Valt, Monoid, OSTNode<Valt, InlineNode<Valt>, Monoid>>;
 }
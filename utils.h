@@ -9,11 +9,16 @@
 #include <utility>
 #include <random>
 #include <filesystem>
+#include <memory_resource>
+#include <memory>
+#include <cstdint>
 
 
 #define INLINE inline
 #define MOVE std::move
 //#define LOG_CONST_ASSIGN
+// with _DEBUG, hold nodes by shared_ptr instead of generation-checked handles
+//#define SHARED_NODEPTR
 
 
 using namespace std::chrono;
@@ -589,6 +594,87 @@ namespace lyf
 	};
 
 
+	template<typename Node>
+	class _CheckedNodeContainer;
+
+	template<typename Node>
+	class _NodeHandle
+	{	// a node pointer with the generation the node's memory had when the handle was made.
+		// the generation lives in a header before the node and changes when the node is deleted,
+		// so a stale handle throws instead of using the node, and copies cost no reference counting.
+		// the memory stays readable until the container is destroyed, which ends every handle
+		friend class _CheckedNodeContainer<Node>;
+
+	public:
+		_NodeHandle() noexcept
+			: _pNode(nullptr), _Gen(0)
+		{
+		}
+
+		_NodeHandle(std::nullptr_t) noexcept
+			: _NodeHandle()
+		{
+		}
+
+		Node *get() const
+		{
+			if (_pNode && _generation(_pNode) != _Gen)
+				throw std::runtime_error("The node has been deleted!");
+			return _pNode;
+		}
+
+		Node *operator->() const
+		{
+			return get();
+		}
+
+		Node &operator*() const
+		{
+			return *get();
+		}
+
+		explicit operator bool() const noexcept
+		{
+			return _pNode != nullptr;
+		}
+
+		friend bool operator==(const _NodeHandle &lhs, const _NodeHandle &rhs) noexcept
+		{
+			return lhs._pNode == rhs._pNode && lhs._Gen == rhs._Gen;
+		}
+
+		friend bool operator!=(const _NodeHandle &lhs, const _NodeHandle &rhs) noexcept
+		{
+			return !(lhs == rhs);
+		}
+
+	private:
+		Node *_pNode;
+		uint32_t _Gen;
+
+		explicit _NodeHandle(Node *pNode) noexcept
+			: _pNode(pNode), _Gen(_generation(pNode))
+		{
+		}
+
+		// bytes before the node, enough for the generation and keeping the node aligned
+		static constexpr size_t _header_size()
+		{
+			return (sizeof(uint32_t) + alignof(Node) - 1) / alignof(Node) * alignof(Node);
+		}
+
+		static constexpr size_t _align()
+		{
+			return alignof(Node) > alignof(uint32_t) ? alignof(Node) : alignof(uint32_t);
+		}
+
+		static uint32_t &_generation(Node *pNode) noexcept
+		{
+			return *reinterpret_cast<uint32_t*>(reinterpret_cast<char*>(pNode) - _header_size());
+		}
+	};
+
+
 	class _CheckedNode
 	{
 	protected:
@@ -644,47 +730,168 @@ namespace lyf
 
 	template<typename Node>
 	class _CheckedNodeContainer
-	{
+	{	// the nodes of a container come from its memory resource and go back to it
+		// with the node's own size and alignment, so they carry no allocation header.
+		// with _DEBUG, nodes are held by _NodeHandle and deleted nodes go to a free list
+		// of the container instead of the resource, taking and freeing a node needs no lock
 	public:
-#if _DEBUG
+#if _DEBUG && defined(SHARED_NODEPTR)
 		using nodeptr = std::shared_ptr<Node>;
+#elif _DEBUG
+		using nodeptr = _NodeHandle<Node>;
 #else
 		using nodeptr = Node * ;
 #endif
 
-		static nodeptr _new_node(Node *pNode)
+		explicit _CheckedNodeContainer(std::pmr::memory_resource *pResource = std::pmr::get_default_resource()) noexcept
+			: _pResource(pResource)
 		{
-#if _DEBUG
-			return nodeptr(pNode);
+		}
+
+		// a copy uses the same resource, the free list stays with the original
+		_CheckedNodeContainer(const _CheckedNodeContainer &rhs) noexcept
+			: _pResource(rhs._pResource)
+		{
+		}
+
+		_CheckedNodeContainer &operator=(const _CheckedNodeContainer &) = delete;
+
+		~_CheckedNodeContainer()
+		{
+			this->_release_free();
+		}
+
+		// the memory resource new nodes are allocated from
+		std::pmr::memory_resource *get_resource() const
+		{
+			return _pResource;
+		}
+
+		// Construct a node which is never deleted, like the sentinels
+		template<typename... Types>
+		static nodeptr _new_static_node(Types&&... args)
+		{
+#if _DEBUG && !defined(SHARED_NODEPTR)
+			using handle_t = _NodeHandle<Node>;
+			char *p = static_cast<char*>(std::pmr::new_delete_resource()->allocate(
+				handle_t::_header_size() + sizeof(Node), handle_t::_align()));
+			new (p) uint32_t(0);
+			return nodeptr(new (p + handle_t::_header_size()) Node(std::forward<Types>(args)...));
 #else
-			return pNode;
+			return nodeptr(new Node(std::forward<Types>(args)...));
 #endif
 		}
 
-		static void _assign_node(nodeptr &ln, Node *pNode)
+		static void _set_out(nodeptr np)
 		{
-#if _DEBUG
-			ln.reset(pNode);
+			np->_setCont();
+		}
+
+	protected:
+		std::pmr::memory_resource *_pResource;
+
+		// Construct a node in memory from the container's resource
+		template<typename... Types>
+		nodeptr _make_node(Types&&... args)
+		{
+			Node *pNode = this->_allocate();
+			try
+			{
+				new (pNode) Node(std::forward<Types>(args)...);
+			}
+			catch (...)
+			{
+				this->_deallocate(pNode);
+				throw;
+			}
+#if _DEBUG && defined(SHARED_NODEPTR)
+			std::pmr::memory_resource *pResource = _pResource;
+			return nodeptr(pNode, [pResource](Node *p) {
+				p->~Node();
+				pResource->deallocate(p, sizeof(Node), alignof(Node));
+			});
 #else
-			ln = pNode;
+			return nodeptr(pNode);
 #endif
 		}
 
-		static void _delete_node(nodeptr np)
+		void _delete_node(nodeptr np)
 		{
-#if _DEBUG
+#if _DEBUG && defined(SHARED_NODEPTR)
 			np->_reset_neighbors();
 			np->_setCont();
 			np.reset();
 #else
-			delete np;
+			Node *pNode = &*np;
+			pNode->~Node();
+			this->_deallocate(pNode);
 #endif
 		}
 
-		static void _set_out(nodeptr np)
+		// allocate the nodes from another resource, the container must have no nodes
+		void _set_resource(std::pmr::memory_resource *pResource)
 		{
-			np->_setCont();
+			this->_release_free();
+			_pResource = pResource;
+		}
+
+		// nodes move between containers only if they free them to the same resource
+		void _ensure_same_resource(const _CheckedNodeContainer &rhs) const
+		{
+			if (_pResource != rhs._pResource)
+				throw std::runtime_error("The containers use different memory resources");
 		}
+
+	private:
+#if _DEBUG && !defined(SHARED_NODEPTR)
+		using handle_t = _NodeHandle<Node>;
+
+		void *_pFree = nullptr;	// deleted nodes, linked through their first bytes
+
+		Node *_allocate()
+		{
+			if (_pFree)
+			{
+				Node *pNode = static_cast<Node*>(_pFree);
+				_pFree = *static_cast<void**>(_pFree);
+				return pNode;
+			}
+			char *p = static_cast<char*>(_pResource->allocate(handle_t::_header_size() + sizeof(Node), handle_t::_align()));
+			new (p) uint32_t(0);
+			return reinterpret_cast<Node*>(p + handle_t::_header_size());
+		}
+
+		void _deallocate(Node *pNode)
+		{	// the new generation invalidates every handle to the node
+			handle_t::_generation(pNode)++;
+			*reinterpret_cast<void**>(pNode) = _pFree;
+			_pFree = pNode;
+		}
+
+		void _release_free()
+		{
+			while (_pFree)
+			{
+				char *p = static_cast<char*>(_pFree);
+				_pFree = *static_cast<void**>(_pFree);
+				_pResource->deallocate(p - handle_t::_header_size(), handle_t::_header_size() + sizeof(Node), handle_t::_align());
+			}
+		}
+#else
+		Node *_allocate()
+		{
+			return static_cast<Node*>(_pResource->allocate(sizeof(Node), alignof(Node)));
+		}
+
+		void _deallocate(Node *pNode)
+		{
+			_pResource->deallocate(pNode, sizeof(Node), alignof(Node));
+		}
+
+		void _release_free()
+		{
+		}
+#endif
 	};
 
 
@@ -789,6 +996,87 @@ namespace lyf
 		std::unique_ptr<Valt> _pVal = nullptr;
 
 	};
+
+	template<typename Valt>
+	class InlineNode : public _CheckedNode
+	{	// stores the value inside the node, so a node costs a single allocation.
+		// default constructed nodes hold no value, they are only used as sentinels
+	public:
+		using _MyBase = _CheckedNode;
+		using value_type = Valt;
+
+		value_type &value()
+		{
+			_ensureInCont();
+			return _Val;
+		}
+
+		~InlineNode()
+		{
+			if (_HasVal)
+				_Val.~Valt();
+		}
+
+	protected:
+		InlineNode()
+			: _HasVal(false)
+		{
+		}
+
+		InlineNode(const InlineNode &rhs)
+			:_MyBase(rhs), _HasVal(false)
+		{
+			if (rhs._HasVal)
+			{
+				new (&_Val) Valt(rhs._Val);
+				_HasVal = true;
+			}
+		}
+
+		InlineNode &operator=(const InlineNode &rhs)
+		{
+			if (this != &rhs)
+			{
+				_MyBase::operator=(rhs);
+				if (_HasVal && rhs._HasVal)
+					_Val = rhs._Val;
+				else if (rhs._HasVal)
+				{
+					new (&_Val) Valt(rhs._Val);
+					_HasVal = true;
+				}
+				else if (_HasVal)
+				{
+					_Val.~Valt();
+					_HasVal = false;
+				}
+			}
+			return *this;
+		}
+
+		InlineNode(void *pCont, const Valt &value)
+			:_MyBase(pCont), _Val(value), _HasVal(true)
+		{
+		}
+
+		InlineNode(void *pCont, Valt &&value)
+			:_MyBase(pCont), _Val(std::move(value)), _HasVal(true)
+		{
+		}
+
+		template<typename... Types>
+		InlineNode(void *pCont, Types&&... args)
+			: _MyBase(pCont), _Val(std::forward<Types>(args)...), _HasVal(true)
+		{
+		}
+
+		union
+		{
+			Valt _Val;
+		};
+		bool _HasVal;
+
+	};
 	
 	template<typename T>
 	INLINE size_t hash(const T &v, std::decay_t<decltype(std::hash<T>())>* = nullptr)
@@ -994,6 +1282,16 @@ namespace lyf
 			memcpy(&value, raw.data(), sizeof(Valt));
 		}
 
+		inline static void serialize(char *dst, const Valt &value)
+		{
+			memcpy(dst, &value, sizeof(Valt));
+		}
+
+		inline static void unserialize(const char *src, Valt &value)
+		{
+			memcpy(&value, src, sizeof(Valt));
+		}
+
 		inline static std::unique_ptr<Valt> unserialize(std::ifstream &inf)
 		{
 			std::unique_ptr<Valt> ret(new Valt);
@@ -1039,6 +1337,16 @@ namespace lyf
 			traversalTuple(value, [&](auto &e) { ss.read(reinterpret_cast<char*>(&e), sizeof(e)); });
 		}
 
+		inline static void serialize(char *dst, const Valt &value)
+		{
+			traversalTuple(value, [&](const auto &e) { memcpy(dst, &e, sizeof(e)); dst += sizeof(e); });
+		}
+
+		inline static void unserialize(const char *src, Valt &value)
+		{
+			traversalTuple(value, [&](auto &e) { memcpy(&e, src, sizeof(e)); src += sizeof(e); });
+		}
+
 		inline static std::unique_ptr<Valt> unserialize(std::ifstream &inf)
 		{
 			std::unique_ptr<Valt> ret(new Valt);
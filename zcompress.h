@@ -261,7 +261,7 @@ namespace lyf
 					np->left = heap.pop();
 					np->right = heap.pop();
 					np->freq = np->left->freq + np->right->freq;
-					heap.insert(np);
+					heap.insert(std::move(np));
 				}
 				_pRoot = heap.pop();
 				if (_pUnit2Node->size() == 1)